@@ -1,5 +1,5 @@
 
-QT += core gui widgets
+QT += core gui widgets concurrent
 QT += 3dcore 3drender 3dinput 3dextras
 LIBS += -lz
 
@@ -42,6 +42,8 @@ SOURCES += \
     element.cpp \
     elementselector.cpp \
     filehandlers.cpp \
+    isosurfacecache.cpp \
+    isosurfacemesh.cpp \
     jsonquery.cpp \
     linebuffer.cpp \
     main.cpp \
@@ -73,7 +75,8 @@ SOURCES += \
     toolbarpropswidget.cpp \
     unitslineedit.cpp \
     vector3d.cpp \
-    volumedata.cpp
+    volumedata.cpp \
+    volumehandle.cpp
 
 HEADERS += \
     arcball.h \
@@ -84,6 +87,8 @@ HEADERS += \
     element.h \
     elementselector.h \
     filehandlers.h \
+    isosurfacecache.h \
+    isosurfacemesh.h \
     jsonquery.h \
     linebuffer.h \
     mainwindow.h \
@@ -114,7 +119,8 @@ HEADERS += \
     toolbarpropswidget.h \
     unitslineedit.h \
     vector3d.h \
-    volumedata.h
+    volumedata.h \
+    volumehandle.h
 
 FORMS += \
     configurecalculationdialog.ui \
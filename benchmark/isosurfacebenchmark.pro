@@ -0,0 +1,33 @@
+
+# Standalone benchmark for the isosurface extraction engines, built separately from ChemView.pro:
+#   qmake benchmark/isosurfacebenchmark.pro && make && ./isosurfacebenchmark
+
+QT += core gui concurrent
+QT -= widgets
+
+TARGET = isosurfacebenchmark
+CONFIG += console c++17
+CONFIG -= app_bundle
+
+!win32-msvc* {
+    QMAKE_CXXFLAGS_WARN_ON += -Wno-missing-braces -Wno-missing-field-initializers -Wno-unused-parameter
+    CONFIG += warn_on
+}
+else {
+    QMAKE_CXXFLAGS_WARN_ON = -W3 -wd4100 -wd4267 -wd4305 -w14701 -w14703
+    CONFIG += warn_on
+    LIBS += -lpsapi
+}
+
+QMAKE_CXXFLAGS += -O2
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    main.cpp \
+    ../isosurfacemesh.cpp \
+    ../volumedata.cpp
+
+HEADERS += \
+    ../isosurfacemesh.h \
+    ../volumedata.h
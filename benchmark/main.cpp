@@ -0,0 +1,221 @@
+#include "isosurfacemesh.h"
+#include "volumedata.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QThread>
+#include <QVector4D>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <random>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+// Peak resident memory of the process so far, in MiB
+double peakMemoryMiB()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0.0;
+    return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0.0;
+#if defined(Q_OS_MACOS)
+    return usage.ru_maxrss / (1024.0 * 1024.0); // bytes
+#else
+    return usage.ru_maxrss / 1024.0; // KiB
+#endif
+#endif
+}
+
+// A cube of size^3 points covering -extent to extent on each axis, filled from fn(x, y, z)
+VolumeData makeVolume(int size, float extent, std::function<float(float, float, float)> const &fn)
+{
+    VolumeData volume(size, size, size);
+    const float step = 2.0f * extent / (size - 1);
+    volume.transform.translate(-extent, -extent, -extent);
+    volume.transform.scale(step);
+
+    float *out = volume.mutableValues();
+    for (int x = 0; x < size; ++x)
+        for (int y = 0; y < size; ++y)
+            for (int z = 0; z < size; ++z)
+                *out++ = fn(x * step - extent, y * step - extent, z * step - extent);
+
+    return volume;
+}
+
+// A few overlapping blobs, like the density of a small molecule
+VolumeData gaussians(int size)
+{
+    const QVector<QVector4D> centers = {
+        {0.0f, 0.0f, 0.0f, 1.0f}, {1.4f, 0.0f, 0.0f, 0.8f}, {-0.7f, 1.2f, 0.0f, 0.8f},
+        {-0.7f, -1.2f, 0.0f, 0.8f}, {0.0f, 0.0f, 1.5f, 0.5f}, {2.5f, 1.0f, -0.5f, 0.4f}
+    };
+    return makeVolume(size, 5.0f, [&centers](float x, float y, float z) {
+        float value = 0.0f;
+        for (auto const &c: centers)
+        {
+            float r2 = (x - c.x()) * (x - c.x()) + (y - c.y()) * (y - c.y()) + (z - c.z()) * (z - c.z());
+            value += c.w() * std::exp(-2.0f * r2);
+        }
+        return value;
+    });
+}
+
+// The hydrogen 3d(z^2) orbital in atomic units, a signed volume with both lobes
+VolumeData orbital(int size)
+{
+    return makeVolume(size, 20.0f, [](float x, float y, float z) {
+        float r2 = x * x + y * y + z * z;
+        return (3.0f * z * z - r2) * std::exp(-std::sqrt(r2) / 3.0f) / 81.0f;
+    });
+}
+
+// Smoothed random values, a worst case with many small disconnected pieces
+VolumeData noise(int size)
+{
+    const int coarseSize = std::max(size / 8, 2);
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    VolumeData coarse = makeVolume(coarseSize, 1.0f, [&](float, float, float) { return distribution(random); });
+
+    VolumeData volume(size, size, size);
+    volume.transform.translate(-1.0f, -1.0f, -1.0f);
+    volume.transform.scale(2.0f / (size - 1));
+    QVector<QVector3D> row(size);
+    float *values = volume.mutableValues();
+    for (int x = 0; x < size; ++x)
+    {
+        for (int y = 0; y < size; ++y)
+        {
+            for (int z = 0; z < size; ++z)
+                row[z] = volume.transform.map(QVector3D(x, y, z));
+            coarse.sample(row.constData(), size, values + (x * size + y) * size);
+        }
+    }
+    return volume;
+}
+
+QString meshChecksum(IsosurfaceMesh const &mesh)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(mesh.vertexData);
+    hash.addData(mesh.indexData);
+    return QString::fromLatin1(hash.result().toHex().left(16));
+}
+
+QList<int> parseIntList(QString const &value)
+{
+    QList<int> result;
+    for (auto const &part: value.split(',', Qt::SkipEmptyParts))
+        result.push_back(part.toInt());
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("isosurfacebenchmark");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures the isosurface engines on synthetic volumes");
+    parser.addHelpOption();
+    QCommandLineOption sizesOption("sizes", "Comma separated volume sizes, in points per axis", "sizes", "64,128,192");
+    QCommandLineOption threadsOption("threads", "Comma separated thread counts, 0 for one per core", "threads",
+                                     QStringLiteral("1,%1").arg(QThread::idealThreadCount()));
+    QCommandLineOption repeatOption("repeat", "Builds per measurement, the fastest is reported", "count", "3");
+    parser.addOption(sizesOption);
+    parser.addOption(threadsOption);
+    parser.addOption(repeatOption);
+    parser.process(app);
+
+    const QList<int> sizes = parseIntList(parser.value(sizesOption));
+    const QList<int> threadCounts = parseIntList(parser.value(threadsOption));
+    const int repeat = std::max(parser.value(repeatOption).toInt(), 1);
+
+    const QList<QPair<QString, std::function<VolumeData(int)>>> generators = {
+        {"gaussians", gaussians},
+        {"orbital", orbital},
+        {"noise", noise}
+    };
+    const QList<QPair<QString, IsosurfaceOptions::Engine>> engines = {
+        {"MarchingCubes", IsosurfaceOptions::Engine::MarchingCubes},
+        {"FlyingEdges", IsosurfaceOptions::Engine::FlyingEdges}
+    };
+
+    QTextStream out(stdout);
+    out << QStringLiteral("%1 %2 %3 %4 %5 %6 %7 %8 %9\n")
+           .arg("volume", -10).arg("size", 5).arg("engine", -14).arg("threads", 7).arg("ms", 9)
+           .arg("Mcells/s", 9).arg("Mtris/s", 8).arg("peakMiB", 8).arg("checksum");
+
+    bool mismatch = false;
+    for (auto const &generator: generators)
+    {
+        for (int size: sizes)
+        {
+            VolumeData volume = generator.second(size);
+            // The surface enclosing most of the density, as the properties window offers
+            const float threshold = volume.statistics().thresholdForEnclosedFraction(0.9f);
+            const double cells = double(size - 1) * (size - 1) * (size - 1);
+
+            for (auto const &engine: engines)
+            {
+                // The mesh mustn't depend on the thread count
+                QString reference;
+                for (int threads: threadCounts)
+                {
+                    IsosurfaceOptions options;
+                    options.engine = engine.second;
+                    options.threadCount = threads;
+                    options.dual = volume.statistics().isSigned();
+
+                    IsosurfaceMesh mesh;
+                    qint64 best = std::numeric_limits<qint64>::max();
+                    for (int i = 0; i < repeat; ++i)
+                    {
+                        QElapsedTimer timer;
+                        timer.start();
+                        mesh = IsosurfaceMesh::build(volume, threshold, options);
+                        best = std::min(best, timer.nsecsElapsed());
+                    }
+
+                    const double seconds = std::max(best, qint64(1)) / 1.0e9;
+                    const double triangles = mesh.indexCount / 3;
+                    QString checksum = meshChecksum(mesh);
+                    if (reference.isEmpty())
+                        reference = checksum;
+                    else if (checksum != reference)
+                        mismatch = true;
+
+                    out << QStringLiteral("%1 %2 %3 %4 %5 %6 %7 %8 %9%10\n")
+                           .arg(generator.first, -10).arg(size, 5).arg(engine.first, -14).arg(threads, 7)
+                           .arg(seconds * 1000.0, 9, 'f', 2).arg(cells / seconds / 1.0e6, 9, 'f', 1)
+                           .arg(triangles / seconds / 1.0e6, 8, 'f', 2).arg(peakMemoryMiB(), 8, 'f', 1)
+                           .arg(checksum).arg(checksum == reference ? QString() : QStringLiteral(" MISMATCH"));
+                    out.flush();
+                }
+            }
+        }
+    }
+
+    if (mismatch)
+        out << "Meshes differ between thread counts\n";
+    return mismatch ? 1 : 0;
+}
@@ -3,16 +3,90 @@
 #include "parsehelpers.h"
 
 #include <QDebug>
-#include <QRegularExpression>
+#include <QThread>
+#include <QtConcurrentMap>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
 
 MolDocument CubeFile::fromCube(const QString &filename)
 {
-    QByteArray source;
+    std::unique_ptr<MappedFile> source;
 
-    try {source = readFile(filename); }
+    try {source.reset(new MappedFile(filename)); }
     catch (QString err) { throw QStringLiteral("Cube: ") + err; }
 
-    return fromCubeData(source);
+    return fromCubeData(source->data());
+}
+
+namespace {
+    // Split the line starting at pos into fields and advance pos to the start of the next line
+    QStringList nextLineFields(const char *&pos, const char *end)
+    {
+        if (pos == end)
+            throw QString("CubeFile: Unexpected end of file");
+
+        const char *lineEnd = static_cast<const char *>(memchr(pos, '\n', end - pos));
+        if (!lineEnd)
+            lineEnd = end;
+
+        const char *next = lineEnd == end ? end : lineEnd + 1;
+        if (lineEnd != pos && *(lineEnd - 1) == '\r')
+            lineEnd--;
+
+        QString line = QString::fromUtf8(pos, lineEnd - pos);
+        pos = next;
+        return line.split(" ", Qt::SkipEmptyParts);
+    }
+
+    struct PayloadChunk {
+        const char *begin = nullptr;
+        const char *end = nullptr;
+        qint64 offset = 0;
+        qint64 count = 0;
+        QString error;
+    };
+
+    // Split [begin, end) into newline aligned chunks of at least minChunkSize bytes
+    QVector<PayloadChunk> splitPayload(const char *begin, const char *end, int maxChunks)
+    {
+        const qint64 minChunkSize = 1024 * 1024;
+
+        QVector<PayloadChunk> chunks;
+        qint64 chunkSize = std::max(minChunkSize, qint64(end - begin) / std::max(1, maxChunks));
+
+        while (begin != end)
+        {
+            PayloadChunk chunk;
+            chunk.begin = begin;
+            if (end - begin <= chunkSize)
+                chunk.end = end;
+            else
+            {
+                const char *lineEnd = static_cast<const char *>(memchr(begin + chunkSize, '\n', end - begin - chunkSize));
+                chunk.end = lineEnd ? lineEnd + 1 : end;
+            }
+            begin = chunk.end;
+            chunks.push_back(chunk);
+        }
+
+        return chunks;
+    }
+
+    qint64 countFields(const char *pos, const char *end)
+    {
+        qint64 count = 0;
+        bool inField = false;
+        for (; pos != end; pos++)
+        {
+            bool isSpace = (*pos == ' ' || *pos == '\n' || *pos == '\r' || *pos == '\t' || *pos == '\v' || *pos == '\f');
+            if (!isSpace && !inField)
+                count++;
+            inField = !isSpace;
+        }
+        return count;
+    }
 }
 
 MolDocument CubeFile::fromCubeData(const QByteArray &source)
@@ -21,15 +95,16 @@ MolDocument CubeFile::fromCubeData(const QByteArray &source)
 
     MolDocument result;
 
-    QStringList data = QString(source).split(QRegularExpression("[\r\n]"));
-    auto data_iter = data.begin();
-    data_iter++; // Comment line
-    data_iter++; // Comment line
-    QStringList line = (data_iter++)->split(" ", Qt::SkipEmptyParts);
+    const char *pos = source.constData();
+    const char *end = pos + source.size();
+
+    nextLineFields(pos, end); // Comment line
+    nextLineFields(pos, end); // Comment line
+    QStringList line = nextLineFields(pos, end);
     int numAtoms = intFromList(line, 0);
     QVector3D origin(doubleFromList(line, 1), doubleFromList(line, 2) , doubleFromList(line, 3));
 
-    line = (data_iter++)->split(" ", Qt::SkipEmptyParts);
+    line = nextLineFields(pos, end);
     int xPoints = intFromList(line, 0);
     double unitScale = 0.529177;
     if (xPoints < 0)
@@ -39,13 +114,13 @@ MolDocument CubeFile::fromCubeData(const QByteArray &source)
                                 doubleFromList(line, 2),
                                 doubleFromList(line, 3)) * unitScale;
 
-    line = (data_iter++)->split(" ", Qt::SkipEmptyParts);
+    line = nextLineFields(pos, end);
     int yPoints = intFromList(line, 0);
     QVector3D yStep = QVector3D(doubleFromList(line, 1),
                                 doubleFromList(line, 2),
                                 doubleFromList(line, 3)) * unitScale;
 
-    line = (data_iter++)->split(" ", Qt::SkipEmptyParts);
+    line = nextLineFields(pos, end);
     int zPoints = intFromList(line, 0);
     QVector3D zStep = QVector3D(doubleFromList(line, 1),
                                 doubleFromList(line, 2),
@@ -55,9 +130,20 @@ MolDocument CubeFile::fromCubeData(const QByteArray &source)
     yPoints = abs(yPoints);
     zPoints = abs(zPoints);
 
+    // Volumes index their values with an int and store them in a single QVector
+    const qint64 maxPoints = (std::numeric_limits<int>::max() - 64) / qint64(sizeof(float));
+    const qint64 volumePoints = qint64(xPoints) * yPoints * zPoints;
+    if (volumePoints > maxPoints)
+        throw QString("CubeFile: Volume of %1x%2x%3 points is too large").arg(xPoints).arg(yPoints).arg(zPoints);
+
+    // A negative atom count means the atoms are followed by a list of orbital indices,
+    // and the payload interleaves one value per orbital for each voxel.
+    bool hasOrbitalList = numAtoms < 0;
+    numAtoms = abs(numAtoms);
+
     while (numAtoms--)
     {
-        line = (data_iter++)->split(" ", Qt::SkipEmptyParts);
+        line = nextLineFields(pos, end);
         Atom a;
         Element e = Element::fromAtomicNumber(doubleFromList(line, 0));
         a.element = e.abbr;
@@ -69,29 +155,93 @@ MolDocument CubeFile::fromCubeData(const QByteArray &source)
         result.molecule.atoms.push_back(a);
     }
 
-    VolumeData volume;
+    QStringList volumeNames{"default"};
+    if (hasOrbitalList)
+    {
+        line = nextLineFields(pos, end);
+        int numOrbitals = intFromList(line, 0);
+        if (numOrbitals < 1)
+            throw QString("CubeFile: Invalid orbital count %1").arg(numOrbitals);
+
+        // The index list wraps onto additional lines for large orbital counts
+        while (line.size() < numOrbitals + 1)
+            line += nextLineFields(pos, end);
+
+        volumeNames.clear();
+        for (int i = 1; i <= numOrbitals; ++i)
+            volumeNames.push_back(QString::number(intFromList(line, i)));
+    }
 
-    volume.data.reserve(xPoints * yPoints * zPoints);
-    volume.xDim = xPoints;
-    volume.yDim = yPoints;
-    volume.zDim = zPoints;
+    QMatrix4x4 transform(xStep.x(), yStep.x(), zStep.x(), origin.x(),
+                         xStep.y(), yStep.y(), zStep.y(), origin.y(),
+                         xStep.z(), yStep.z(), zStep.z(), origin.z(),
+                         0, 0, 0, 1);
 
-    while (data_iter != data.end())
+    const int numFields = volumeNames.size();
+    QVector<VolumeData> volumes;
+    QVector<float *> out;
+    for (int i = 0; i < numFields; ++i)
     {
-        line = (data_iter++)->split(" ", Qt::SkipEmptyParts);
-        for (auto const &s: line)
-            volume.data.push_back(toDoubleOrThrow(s));
+        volumes.push_back(VolumeData(xPoints, yPoints, zPoints));
+        volumes.last().transform = transform;
     }
+    for (auto &volume: volumes)
+        out.push_back(volume.mutableValues());
+
+    const qint64 expectedPoints = volumePoints * numFields;
+
+    // The rest of the file is just whitespace separated values, so rather than splitting
+    // it into lines we scan the raw bytes and write the values directly into the volume.
+    // The payload is split into chunks that are parsed in parallel, a counting pass first
+    // finds where each chunk's values start in the volume.
+    QVector<PayloadChunk> chunks = splitPayload(pos, end, QThread::idealThreadCount() * 4);
 
-    if ((int)volume.data.size() != xPoints * yPoints * zPoints)
-        throw QString("CubeFile: Expected %1 datapoints but found %2").arg(xPoints * yPoints * zPoints).arg(volume.data.size());
+    QtConcurrent::blockingMap(chunks, [](PayloadChunk &chunk) {
+        chunk.count = countFields(chunk.begin, chunk.end);
+    });
 
-    volume.transform = QMatrix4x4(xStep.x(), yStep.x(), zStep.x(), origin.x(),
-                                         xStep.y(), yStep.y(), zStep.y(), origin.y(),
-                                         xStep.z(), yStep.z(), zStep.z(), origin.z(),
-                                         0, 0, 0, 1);
+    qint64 foundPoints = 0;
+    for (auto &chunk: chunks)
+    {
+        chunk.offset = foundPoints;
+        foundPoints += chunk.count;
+    }
 
-    result.volumes["default"] = volume;
+    // Values are de-interleaved into their volumes as they're parsed
+    float * const *outFields = out.constData();
+    QtConcurrent::blockingMap(chunks, [outFields, numFields, expectedPoints](PayloadChunk &chunk) {
+        try {
+            const char *chunkPos = chunk.begin;
+            qint64 idx = chunk.offset;
+            qint64 voxel = idx / numFields;
+            int field = int(idx % numFields);
+            double value;
+            while (scanDoubleOrThrow(chunkPos, chunk.end, value))
+            {
+                if (idx < expectedPoints)
+                    outFields[field][voxel] = value;
+                idx++;
+                if (++field == numFields)
+                {
+                    field = 0;
+                    voxel++;
+                }
+            }
+        } catch (QString err) {
+            chunk.error = err;
+        }
+    });
+
+    for (auto const &chunk: chunks)
+        if (!chunk.error.isEmpty())
+            throw chunk.error;
+
+    if (foundPoints != expectedPoints)
+        throw QString("CubeFile: Expected %1 datapoints but found %2").arg(expectedPoints).arg(foundPoints);
+
+    VolumeData::Encoding encoding = VolumeData::defaultEncoding();
+    for (int i = 0; i < numFields; ++i)
+        result.volumes[volumeNames[i]] = volumes[i].encoded(encoding);
     result.molecule.percieveBonds();
     return result;
 }
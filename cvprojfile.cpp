@@ -5,6 +5,9 @@
 #include "qzipreader.h"
 #include "optimizernwchem.h"
 
+#include <QDebug>
+#include <zlib.h>
+
 MolDocument CVJSONFile::fromPath(const QString &filename)
 {
     QByteArray source;
@@ -195,6 +198,217 @@ QByteArray CVJSONFile::write(const MolDocument &document)
     return doc.toJson();
 }
 
+namespace {
+    const QString volumesDirectory = QStringLiteral("volumes/");
+    const QString surfacesDirectory = QStringLiteral("surfaces/");
+    const QString surfacesIndex = QStringLiteral("surfaces.json");
+
+    struct VolumeChecksum {
+        uint crc;
+        qint64 size;
+    };
+
+    struct VolumeEntrySource {
+        std::function<VolumeData()> loader;
+        std::function<QByteArray()> reader;
+    };
+
+    // Volumes are only decoded once something needs them. Saving again copies the entry's
+    // bytes, the CRC check catches an archive that was rewritten since it was opened.
+    VolumeEntrySource volumeEntrySource(QString const &filename, QZipReader::FileInfo const &zipInfo)
+    {
+        QString name = zipInfo.filePath.mid(volumesDirectory.size());
+        QString entryPath = zipInfo.filePath;
+        uint entryCrc = zipInfo.crc;
+        auto reader = [filename, entryPath, name, entryCrc]() {
+            QZipReader reader(filename);
+            QByteArray volumeData = reader.fileData(entryPath);
+            if (reader.status() != QZipReader::Status::NoError || volumeData.isEmpty())
+                throw QStringLiteral("Error reading volume \"%1\" from %2").arg(name).arg(filename);
+            if (crc32(0, reinterpret_cast<const Bytef *>(volumeData.constData()), volumeData.size()) != entryCrc)
+                throw QStringLiteral("Volume \"%1\" in %2 has changed since it was opened").arg(name).arg(filename);
+            return volumeData;
+        };
+        auto loader = [reader, name]() {
+            QByteArray volumeData = reader();
+            try {
+                return VolumeData(volumeData);
+            } catch (QString err) {
+                throw QStringLiteral("Error reading volume \"%1\": %2").arg(name).arg(err);
+            }
+        };
+        return {loader, reader};
+    }
+
+    // Returns the checksum of each volume's entry, the same values the zip directory records
+    QMap<QString, VolumeChecksum> writeVolumes(QZipWriter &projZipWriter, MolDocument const &document)
+    {
+        QMap<QString, VolumeChecksum> checksums;
+        if (document.volumes.isEmpty())
+            return checksums;
+
+        projZipWriter.addDirectory(volumesDirectory);
+        for (auto iter = document.volumes.begin(); iter != document.volumes.end(); iter++)
+        {
+            // Volumes that were never loaded are copied without decoding them
+            QByteArray volumeData = iter.value().serialized();
+            uint crc = crc32(0, reinterpret_cast<const Bytef *>(volumeData.constData()), volumeData.size());
+            checksums[iter.key()] = {crc, volumeData.size()};
+            projZipWriter.addFile(volumesDirectory + iter.key(), volumeData);
+        }
+
+        return checksums;
+    }
+
+    // Meshes record the checksum of the volume they were built from, so a project whose volume
+    // was replaced won't show a stale surface. Checking them doesn't require decoding the volume.
+    void writeSurfaces(QZipWriter &projZipWriter, MolDocument const &document, QMap<QString, VolumeChecksum> const &checksums)
+    {
+        if (document.activeSurface.isEmpty())
+            return;
+
+        QJsonArray meshes;
+        for (auto const &surface: document.surfaceMeshes)
+        {
+            if (!checksums.contains(surface.volume) || (!surface.property.isEmpty() && !checksums.contains(surface.property)))
+                continue;
+
+            QString entryPath = surfacesDirectory + QString::number(meshes.size());
+            if (meshes.isEmpty())
+                projZipWriter.addDirectory(surfacesDirectory);
+            projZipWriter.addFile(entryPath, surface.mesh.serialize());
+
+            VolumeChecksum checksum = checksums.value(surface.volume);
+            QJsonObject mesh;
+            mesh["volume"] = surface.volume;
+            mesh["threshold"] = surface.threshold;
+            mesh["mode"] = surface.mode;
+            mesh["volume_crc"] = qint64(checksum.crc);
+            mesh["volume_size"] = checksum.size;
+            if (!surface.property.isEmpty())
+            {
+                VolumeChecksum propertyChecksum = checksums.value(surface.property);
+                mesh["property"] = surface.property;
+                mesh["property_crc"] = qint64(propertyChecksum.crc);
+                mesh["property_size"] = propertyChecksum.size;
+            }
+            mesh["path"] = entryPath;
+            meshes.push_back(mesh);
+        }
+
+        QJsonObject root;
+        root["active"] = document.activeSurface;
+        root["threshold"] = document.activeSurfaceThreshold;
+        root["enclosed_fraction"] = document.activeSurfaceEnclosedFraction;
+        if (!document.activeSurfaceProperty.isEmpty())
+            root["property"] = document.activeSurfaceProperty;
+        if (document.activeSurfaceHasRegion)
+        {
+            QVector3D const &min = document.activeSurfaceRegionMin;
+            QVector3D const &max = document.activeSurfaceRegionMax;
+            root["region"] = QJsonArray{min.x(), min.y(), min.z(), max.x(), max.y(), max.z()};
+        }
+        if (!document.activeSurfaceClipPlane.isNull())
+        {
+            QVector4D const &plane = document.activeSurfaceClipPlane;
+            root["clip_plane"] = QJsonArray{plane.x(), plane.y(), plane.z(), plane.w()};
+        }
+        root["meshes"] = meshes;
+
+        QJsonDocument doc;
+        doc.setObject(root);
+        projZipWriter.addFile(surfacesIndex, doc.toJson());
+    }
+
+    void readSurfaces(QZipReader &projZipReader, MolDocument &document)
+    {
+        QByteArray indexData = projZipReader.fileData(surfacesIndex);
+        if (indexData.isEmpty())
+            return;
+
+        QMap<QString, VolumeChecksum> checksums;
+        for (auto const &zipInfo: projZipReader.fileInfoList())
+            if (zipInfo.isFile && zipInfo.filePath.startsWith(volumesDirectory))
+                checksums[zipInfo.filePath.mid(volumesDirectory.size())] = {zipInfo.crc, zipInfo.size};
+
+        // The surfaces can always be rebuilt, so any problem here only costs the saved meshes
+        try {
+            QJsonParseError err;
+            QJsonDocument doc = QJsonDocument::fromJson(indexData, &err);
+            if (doc.isNull())
+                throw err.errorString();
+            JSONQuery json(doc);
+
+            QString active = json.byKey("active").toString();
+            if (!document.volumes.contains(active))
+                return;
+            document.activeSurface = active;
+            document.activeSurfaceThreshold = json.byKey("threshold").toDouble();
+            document.activeSurfaceEnclosedFraction = json.byKey("enclosed_fraction").toDouble();
+
+            QJsonObject rootObj = doc.object();
+            if (rootObj.contains("property"))
+            {
+                QString property = json.byKey("property").toString();
+                if (document.volumes.contains(property))
+                    document.activeSurfaceProperty = property;
+            }
+            if (rootObj.contains("region"))
+            {
+                JSONQuery region = json.byKey("region");
+                document.activeSurfaceHasRegion = true;
+                document.activeSurfaceRegionMin = QVector3D(region.byIndex(0).toDouble(), region.byIndex(1).toDouble(), region.byIndex(2).toDouble());
+                document.activeSurfaceRegionMax = QVector3D(region.byIndex(3).toDouble(), region.byIndex(4).toDouble(), region.byIndex(5).toDouble());
+            }
+            if (rootObj.contains("clip_plane"))
+            {
+                JSONQuery plane = json.byKey("clip_plane");
+                document.activeSurfaceClipPlane = QVector4D(plane.byIndex(0).toDouble(), plane.byIndex(1).toDouble(),
+                                                            plane.byIndex(2).toDouble(), plane.byIndex(3).toDouble());
+            }
+
+            auto unchanged = [&checksums](QString const &volume, JSONQuery crc, JSONQuery size) {
+                auto checksum = checksums.find(volume);
+                return checksum != checksums.end() && checksum->crc == uint(crc.toDouble()) && checksum->size == qint64(size.toDouble());
+            };
+
+            for (auto m: json.byKey("meshes").toArray())
+            {
+                JSONQuery mQuery(m);
+                MolDocument::SurfaceMesh surface;
+                surface.volume = mQuery.byKey("volume").toString();
+                surface.threshold = mQuery.byKey("threshold").toDouble();
+                surface.mode = mQuery.byKey("mode").toString();
+
+                if (!unchanged(surface.volume, mQuery.byKey("volume_crc"), mQuery.byKey("volume_size")))
+                {
+                    qWarning() << "Discarding surface mesh for modified volume:" << surface.volume;
+                    continue;
+                }
+
+                if (m.toObject().contains("property"))
+                {
+                    surface.property = mQuery.byKey("property").toString();
+                    if (!unchanged(surface.property, mQuery.byKey("property_crc"), mQuery.byKey("property_size")))
+                    {
+                        qWarning() << "Discarding surface mesh for modified property volume:" << surface.property;
+                        continue;
+                    }
+                }
+
+                QByteArray meshData = projZipReader.fileData(mQuery.byKey("path").toString());
+                if (meshData.isEmpty())
+                    throw QString("Missing surface mesh data");
+                surface.mesh = IsosurfaceMesh(meshData);
+                document.surfaceMeshes.push_back(surface);
+            }
+        } catch (QString err) {
+            qWarning() << "Error reading saved surfaces:" << err;
+            document.surfaceMeshes.clear();
+        }
+    }
+}
+
 MolDocument CVProjFile::fromPath(const QString &filename)
 {
     QZipReader projZipReader(filename);
@@ -204,7 +418,46 @@ MolDocument CVProjFile::fromPath(const QString &filename)
         throw QString("Error reading file: ") + projZipReader.device()->errorString();
     if (moleculeData.isEmpty())
         throw QString("Missing molecule.json");
-    return CVJSONFile::fromData(moleculeData);
+    MolDocument result = CVJSONFile::fromData(moleculeData);
+
+    for (auto const &zipInfo: projZipReader.fileInfoList())
+    {
+        if (!zipInfo.isFile || !zipInfo.filePath.startsWith(volumesDirectory))
+            continue;
+
+        QString name = zipInfo.filePath.mid(volumesDirectory.size());
+        VolumeEntrySource source = volumeEntrySource(filename, zipInfo);
+        result.volumes[name] = VolumeHandle::fromLoader(source.loader, source.reader);
+    }
+
+    readSurfaces(projZipReader, result);
+
+    return result;
+}
+
+void CVProjFile::attachVolumes(const QString &filename, MolDocument const &document)
+{
+    QZipReader projZipReader(filename);
+    const auto fileInfoList = projZipReader.fileInfoList();
+    if (projZipReader.status() != QZipReader::Status::NoError)
+    {
+        qWarning() << "Error reading saved volumes from" << filename;
+        return;
+    }
+
+    for (auto const &zipInfo: fileInfoList)
+    {
+        if (!zipInfo.isFile || !zipInfo.filePath.startsWith(volumesDirectory))
+            continue;
+
+        QString name = zipInfo.filePath.mid(volumesDirectory.size());
+        if (!document.volumes.contains(name))
+            continue;
+
+        VolumeEntrySource source = volumeEntrySource(filename, zipInfo);
+        VolumeHandle handle = document.volumes.value(name);
+        handle.setLoader(source.loader, source.reader);
+    }
 }
 
 bool CVProjFile::write(QIODevice *file, MolDocument const &document)
@@ -212,6 +465,7 @@ bool CVProjFile::write(QIODevice *file, MolDocument const &document)
     QZipWriter projZipWriter(file);
     QByteArray moleculeData = CVJSONFile::write(document);
     projZipWriter.addFile("molecule.json", moleculeData);
+    writeSurfaces(projZipWriter, document, writeVolumes(projZipWriter, document));
     projZipWriter.close();
 
     return true;
@@ -222,6 +476,7 @@ bool CVProjFile::write(QIODevice *file, MolDocument const &document, const Optim
     QZipWriter projZipWriter(file);
     QByteArray moleculeData = CVJSONFile::write(document);
     projZipWriter.addFile("molecule.json", moleculeData);
+    writeSurfaces(projZipWriter, document, writeVolumes(projZipWriter, document));
     nwchem.saveToProjFile(projZipWriter, "molecule_nwchem");
     projZipWriter.close();
 
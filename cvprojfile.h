@@ -20,6 +20,9 @@ namespace CVProjFile
     MolDocument fromPath(QString const &filename);
     bool write(QIODevice *file, MolDocument const &document);
     bool write(QIODevice *file, MolDocument const &document, const OptimizerNWChem &nwchem);
+    // Once document has been written to filename, load its volumes that aren't in memory from
+    // there rather than the file they were opened from, which may since be moved or changed
+    void attachVolumes(QString const &filename, MolDocument const &document);
 }
 
 #endif // CVPROJFILE_H
@@ -0,0 +1,61 @@
+#include "isosurfacecache.h"
+
+#include <algorithm>
+
+bool IsosurfaceCache::find(Key const &key, IsosurfaceMesh *mesh)
+{
+    auto iter = std::find_if(entries.begin(), entries.end(), [&key](Entry const &entry) {
+        return entry.key == key;
+    });
+    if (iter == entries.end())
+        return false;
+
+    entries.splice(entries.begin(), entries, iter);
+    *mesh = entries.front().mesh;
+    return true;
+}
+
+void IsosurfaceCache::insert(Key const &key, IsosurfaceMesh const &mesh)
+{
+    auto iter = std::find_if(entries.begin(), entries.end(), [&key](Entry const &entry) {
+        return entry.key == key;
+    });
+    if (iter != entries.end())
+    {
+        used -= iter->bytes;
+        entries.erase(iter);
+    }
+
+    qint64 bytes = qint64(mesh.vertexData.size()) + mesh.indexData.size() + mesh.propertyData.size();
+    entries.push_front({key, mesh, bytes});
+    used += bytes;
+
+    // Always keep the newest mesh, even if it's over budget by itself
+    while (used > budget && entries.size() > 1)
+    {
+        used -= entries.back().bytes;
+        entries.pop_back();
+    }
+}
+
+void IsosurfaceCache::clear()
+{
+    entries.clear();
+    used = 0;
+    thresholds.clear();
+}
+
+bool IsosurfaceCache::findThreshold(quint64 volumeId, float enclosedFraction, float *threshold) const
+{
+    auto iter = thresholds.find({volumeId, enclosedFraction});
+    if (iter == thresholds.end())
+        return false;
+
+    *threshold = iter.value();
+    return true;
+}
+
+void IsosurfaceCache::insertThreshold(quint64 volumeId, float enclosedFraction, float threshold)
+{
+    thresholds[{volumeId, enclosedFraction}] = threshold;
+}
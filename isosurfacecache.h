@@ -0,0 +1,57 @@
+#ifndef ISOSURFACECACHE_H
+#define ISOSURFACECACHE_H
+
+#include "isosurfacemesh.h"
+
+#include <QMap>
+#include <QPair>
+#include <QString>
+#include <list>
+
+// Recently built surface meshes of one document, so showing a surface again only needs its
+// buffers uploaded. The least recently used meshes are dropped once they exceed the budget.
+// Not thread safe, it's only used from the GUI thread.
+class IsosurfaceCache
+{
+public:
+    struct Key {
+        quint64 volumeId; // VolumeHandle::id()
+        float threshold;
+        QString mode;     // IsosurfaceOptions::modeKey()
+        quint64 propertyId = 0; // VolumeHandle::id() of the volume mapped onto the mesh, 0 for none
+
+        bool operator==(Key const &other) const
+        {
+            return volumeId == other.volumeId && threshold == other.threshold && mode == other.mode &&
+                   propertyId == other.propertyId;
+        }
+    };
+
+    static const qint64 defaultBudget = qint64(256) * 1024 * 1024;
+
+    explicit IsosurfaceCache(qint64 budget = defaultBudget) : budget(budget) {}
+
+    // Copy the mesh for key into mesh, returns false if it isn't cached
+    bool find(Key const &key, IsosurfaceMesh *mesh);
+    void insert(Key const &key, IsosurfaceMesh const &mesh);
+    void clear();
+
+    // The isovalue found for an enclosed fraction of a volume's density, so its meshes can be
+    // found without loading the volume to compute its statistics again
+    bool findThreshold(quint64 volumeId, float enclosedFraction, float *threshold) const;
+    void insertThreshold(quint64 volumeId, float enclosedFraction, float threshold);
+
+private:
+    struct Entry {
+        Key key;
+        IsosurfaceMesh mesh;
+        qint64 bytes;
+    };
+
+    std::list<Entry> entries; // Most recently used first
+    qint64 budget;
+    qint64 used = 0;
+    QMap<QPair<quint64, float>, float> thresholds;
+};
+
+#endif // ISOSURFACECACHE_H
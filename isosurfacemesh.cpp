@@ -0,0 +1,1918 @@
+#include "isosurfacemesh.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <initializer_list>
+#include <limits>
+#include <queue>
+#include <vector>
+#include <QDataStream>
+#include <QFuture>
+#include <QHash>
+#include <QMatrix4x4>
+#include <QSettings>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrentRun>
+#include <QtEndian>
+#include <QVector3D>
+#include <QDebug>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CHEMVIEW_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CHEMVIEW_NEON
+#endif
+
+/* Marching cubes code from originally from http://paulbourke.net/geometry/polygonise/ */
+namespace  {
+
+class Point3I
+{
+public:
+    Point3I() : Point3I(0,0,0) {}
+    Point3I(int x, int y, int z) : x(x), y(y), z(z) {}
+    int x;
+    int y;
+    int z;
+
+    bool operator==( Point3I const & rhs ) const
+    {
+        if ((x == rhs.x) && (y == rhs.y) && (z == rhs.z))
+            return true;
+        return false;
+    }
+
+    QVector3D toQVector3D() { return QVector3D(x,y,z); }
+};
+
+/* The bits of edgeTable are the edges of a cell the surface crosses, the rows of triTable
+ * are the triangles of the surface as triples of edges, terminated by -1. */
+const int edgeTable[256] = {
+    0x0  , 0x109, 0x203, 0x30a, 0x406, 0x50f, 0x605, 0x70c,
+    0x80c, 0x905, 0xa0f, 0xb06, 0xc0a, 0xd03, 0xe09, 0xf00,
+    0x190, 0x99 , 0x393, 0x29a, 0x596, 0x49f, 0x795, 0x69c,
+    0x99c, 0x895, 0xb9f, 0xa96, 0xd9a, 0xc93, 0xf99, 0xe90,
+    0x230, 0x339, 0x33 , 0x13a, 0x636, 0x73f, 0x435, 0x53c,
+    0xa3c, 0xb35, 0x83f, 0x936, 0xe3a, 0xf33, 0xc39, 0xd30,
+    0x3a0, 0x2a9, 0x1a3, 0xaa , 0x7a6, 0x6af, 0x5a5, 0x4ac,
+    0xbac, 0xaa5, 0x9af, 0x8a6, 0xfaa, 0xea3, 0xda9, 0xca0,
+    0x460, 0x569, 0x663, 0x76a, 0x66 , 0x16f, 0x265, 0x36c,
+    0xc6c, 0xd65, 0xe6f, 0xf66, 0x86a, 0x963, 0xa69, 0xb60,
+    0x5f0, 0x4f9, 0x7f3, 0x6fa, 0x1f6, 0xff , 0x3f5, 0x2fc,
+    0xdfc, 0xcf5, 0xfff, 0xef6, 0x9fa, 0x8f3, 0xbf9, 0xaf0,
+    0x650, 0x759, 0x453, 0x55a, 0x256, 0x35f, 0x55 , 0x15c,
+    0xe5c, 0xf55, 0xc5f, 0xd56, 0xa5a, 0xb53, 0x859, 0x950,
+    0x7c0, 0x6c9, 0x5c3, 0x4ca, 0x3c6, 0x2cf, 0x1c5, 0xcc ,
+    0xfcc, 0xec5, 0xdcf, 0xcc6, 0xbca, 0xac3, 0x9c9, 0x8c0,
+    0x8c0, 0x9c9, 0xac3, 0xbca, 0xcc6, 0xdcf, 0xec5, 0xfcc,
+    0xcc , 0x1c5, 0x2cf, 0x3c6, 0x4ca, 0x5c3, 0x6c9, 0x7c0,
+    0x950, 0x859, 0xb53, 0xa5a, 0xd56, 0xc5f, 0xf55, 0xe5c,
+    0x15c, 0x55 , 0x35f, 0x256, 0x55a, 0x453, 0x759, 0x650,
+    0xaf0, 0xbf9, 0x8f3, 0x9fa, 0xef6, 0xfff, 0xcf5, 0xdfc,
+    0x2fc, 0x3f5, 0xff , 0x1f6, 0x6fa, 0x7f3, 0x4f9, 0x5f0,
+    0xb60, 0xa69, 0x963, 0x86a, 0xf66, 0xe6f, 0xd65, 0xc6c,
+    0x36c, 0x265, 0x16f, 0x66 , 0x76a, 0x663, 0x569, 0x460,
+    0xca0, 0xda9, 0xea3, 0xfaa, 0x8a6, 0x9af, 0xaa5, 0xbac,
+    0x4ac, 0x5a5, 0x6af, 0x7a6, 0xaa , 0x1a3, 0x2a9, 0x3a0,
+    0xd30, 0xc39, 0xf33, 0xe3a, 0x936, 0x83f, 0xb35, 0xa3c,
+    0x53c, 0x435, 0x73f, 0x636, 0x13a, 0x33 , 0x339, 0x230,
+    0xe90, 0xf99, 0xc93, 0xd9a, 0xa96, 0xb9f, 0x895, 0x99c,
+    0x69c, 0x795, 0x49f, 0x596, 0x29a, 0x393, 0x99 , 0x190,
+    0xf00, 0xe09, 0xd03, 0xc0a, 0xb06, 0xa0f, 0x905, 0x80c,
+    0x70c, 0x605, 0x50f, 0x406, 0x30a, 0x203, 0x109, 0x0};
+
+const int triTable[256][16] = {
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 8, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 1, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 8, 3, 9, 8, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 2, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 8, 3, 1, 2, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {9, 2, 10, 0, 2, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {2, 8, 3, 2, 10, 8, 10, 9, 8, -1, -1, -1, -1, -1, -1, -1},
+    {3, 11, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 11, 2, 8, 11, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 9, 0, 2, 3, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 11, 2, 1, 9, 11, 9, 8, 11, -1, -1, -1, -1, -1, -1, -1},
+    {3, 10, 1, 11, 10, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 10, 1, 0, 8, 10, 8, 11, 10, -1, -1, -1, -1, -1, -1, -1},
+    {3, 9, 0, 3, 11, 9, 11, 10, 9, -1, -1, -1, -1, -1, -1, -1},
+    {9, 8, 10, 10, 8, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {4, 7, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {4, 3, 0, 7, 3, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 1, 9, 8, 4, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {4, 1, 9, 4, 7, 1, 7, 3, 1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 2, 10, 8, 4, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {3, 4, 7, 3, 0, 4, 1, 2, 10, -1, -1, -1, -1, -1, -1, -1},
+    {9, 2, 10, 9, 0, 2, 8, 4, 7, -1, -1, -1, -1, -1, -1, -1},
+    {2, 10, 9, 2, 9, 7, 2, 7, 3, 7, 9, 4, -1, -1, -1, -1},
+    {8, 4, 7, 3, 11, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {11, 4, 7, 11, 2, 4, 2, 0, 4, -1, -1, -1, -1, -1, -1, -1},
+    {9, 0, 1, 8, 4, 7, 2, 3, 11, -1, -1, -1, -1, -1, -1, -1},
+    {4, 7, 11, 9, 4, 11, 9, 11, 2, 9, 2, 1, -1, -1, -1, -1},
+    {3, 10, 1, 3, 11, 10, 7, 8, 4, -1, -1, -1, -1, -1, -1, -1},
+    {1, 11, 10, 1, 4, 11, 1, 0, 4, 7, 11, 4, -1, -1, -1, -1},
+    {4, 7, 8, 9, 0, 11, 9, 11, 10, 11, 0, 3, -1, -1, -1, -1},
+    {4, 7, 11, 4, 11, 9, 9, 11, 10, -1, -1, -1, -1, -1, -1, -1},
+    {9, 5, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {9, 5, 4, 0, 8, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 5, 4, 1, 5, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {8, 5, 4, 8, 3, 5, 3, 1, 5, -1, -1, -1, -1, -1, -1, -1},
+    {1, 2, 10, 9, 5, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {3, 0, 8, 1, 2, 10, 4, 9, 5, -1, -1, -1, -1, -1, -1, -1},
+    {5, 2, 10, 5, 4, 2, 4, 0, 2, -1, -1, -1, -1, -1, -1, -1},
+    {2, 10, 5, 3, 2, 5, 3, 5, 4, 3, 4, 8, -1, -1, -1, -1},
+    {9, 5, 4, 2, 3, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 11, 2, 0, 8, 11, 4, 9, 5, -1, -1, -1, -1, -1, -1, -1},
+    {0, 5, 4, 0, 1, 5, 2, 3, 11, -1, -1, -1, -1, -1, -1, -1},
+    {2, 1, 5, 2, 5, 8, 2, 8, 11, 4, 8, 5, -1, -1, -1, -1},
+    {10, 3, 11, 10, 1, 3, 9, 5, 4, -1, -1, -1, -1, -1, -1, -1},
+    {4, 9, 5, 0, 8, 1, 8, 10, 1, 8, 11, 10, -1, -1, -1, -1},
+    {5, 4, 0, 5, 0, 11, 5, 11, 10, 11, 0, 3, -1, -1, -1, -1},
+    {5, 4, 8, 5, 8, 10, 10, 8, 11, -1, -1, -1, -1, -1, -1, -1},
+    {9, 7, 8, 5, 7, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {9, 3, 0, 9, 5, 3, 5, 7, 3, -1, -1, -1, -1, -1, -1, -1},
+    {0, 7, 8, 0, 1, 7, 1, 5, 7, -1, -1, -1, -1, -1, -1, -1},
+    {1, 5, 3, 3, 5, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {9, 7, 8, 9, 5, 7, 10, 1, 2, -1, -1, -1, -1, -1, -1, -1},
+    {10, 1, 2, 9, 5, 0, 5, 3, 0, 5, 7, 3, -1, -1, -1, -1},
+    {8, 0, 2, 8, 2, 5, 8, 5, 7, 10, 5, 2, -1, -1, -1, -1},
+    {2, 10, 5, 2, 5, 3, 3, 5, 7, -1, -1, -1, -1, -1, -1, -1},
+    {7, 9, 5, 7, 8, 9, 3, 11, 2, -1, -1, -1, -1, -1, -1, -1},
+    {9, 5, 7, 9, 7, 2, 9, 2, 0, 2, 7, 11, -1, -1, -1, -1},
+    {2, 3, 11, 0, 1, 8, 1, 7, 8, 1, 5, 7, -1, -1, -1, -1},
+    {11, 2, 1, 11, 1, 7, 7, 1, 5, -1, -1, -1, -1, -1, -1, -1},
+    {9, 5, 8, 8, 5, 7, 10, 1, 3, 10, 3, 11, -1, -1, -1, -1},
+    {5, 7, 0, 5, 0, 9, 7, 11, 0, 1, 0, 10, 11, 10, 0, -1},
+    {11, 10, 0, 11, 0, 3, 10, 5, 0, 8, 0, 7, 5, 7, 0, -1},
+    {11, 10, 5, 7, 11, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {10, 6, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 8, 3, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {9, 0, 1, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 8, 3, 1, 9, 8, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1},
+    {1, 6, 5, 2, 6, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 6, 5, 1, 2, 6, 3, 0, 8, -1, -1, -1, -1, -1, -1, -1},
+    {9, 6, 5, 9, 0, 6, 0, 2, 6, -1, -1, -1, -1, -1, -1, -1},
+    {5, 9, 8, 5, 8, 2, 5, 2, 6, 3, 2, 8, -1, -1, -1, -1},
+    {2, 3, 11, 10, 6, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {11, 0, 8, 11, 2, 0, 10, 6, 5, -1, -1, -1, -1, -1, -1, -1},
+    {0, 1, 9, 2, 3, 11, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1},
+    {5, 10, 6, 1, 9, 2, 9, 11, 2, 9, 8, 11, -1, -1, -1, -1},
+    {6, 3, 11, 6, 5, 3, 5, 1, 3, -1, -1, -1, -1, -1, -1, -1},
+    {0, 8, 11, 0, 11, 5, 0, 5, 1, 5, 11, 6, -1, -1, -1, -1},
+    {3, 11, 6, 0, 3, 6, 0, 6, 5, 0, 5, 9, -1, -1, -1, -1},
+    {6, 5, 9, 6, 9, 11, 11, 9, 8, -1, -1, -1, -1, -1, -1, -1},
+    {5, 10, 6, 4, 7, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {4, 3, 0, 4, 7, 3, 6, 5, 10, -1, -1, -1, -1, -1, -1, -1},
+    {1, 9, 0, 5, 10, 6, 8, 4, 7, -1, -1, -1, -1, -1, -1, -1},
+    {10, 6, 5, 1, 9, 7, 1, 7, 3, 7, 9, 4, -1, -1, -1, -1},
+    {6, 1, 2, 6, 5, 1, 4, 7, 8, -1, -1, -1, -1, -1, -1, -1},
+    {1, 2, 5, 5, 2, 6, 3, 0, 4, 3, 4, 7, -1, -1, -1, -1},
+    {8, 4, 7, 9, 0, 5, 0, 6, 5, 0, 2, 6, -1, -1, -1, -1},
+    {7, 3, 9, 7, 9, 4, 3, 2, 9, 5, 9, 6, 2, 6, 9, -1},
+    {3, 11, 2, 7, 8, 4, 10, 6, 5, -1, -1, -1, -1, -1, -1, -1},
+    {5, 10, 6, 4, 7, 2, 4, 2, 0, 2, 7, 11, -1, -1, -1, -1},
+    {0, 1, 9, 4, 7, 8, 2, 3, 11, 5, 10, 6, -1, -1, -1, -1},
+    {9, 2, 1, 9, 11, 2, 9, 4, 11, 7, 11, 4, 5, 10, 6, -1},
+    {8, 4, 7, 3, 11, 5, 3, 5, 1, 5, 11, 6, -1, -1, -1, -1},
+    {5, 1, 11, 5, 11, 6, 1, 0, 11, 7, 11, 4, 0, 4, 11, -1},
+    {0, 5, 9, 0, 6, 5, 0, 3, 6, 11, 6, 3, 8, 4, 7, -1},
+    {6, 5, 9, 6, 9, 11, 4, 7, 9, 7, 11, 9, -1, -1, -1, -1},
+    {10, 4, 9, 6, 4, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {4, 10, 6, 4, 9, 10, 0, 8, 3, -1, -1, -1, -1, -1, -1, -1},
+    {10, 0, 1, 10, 6, 0, 6, 4, 0, -1, -1, -1, -1, -1, -1, -1},
+    {8, 3, 1, 8, 1, 6, 8, 6, 4, 6, 1, 10, -1, -1, -1, -1},
+    {1, 4, 9, 1, 2, 4, 2, 6, 4, -1, -1, -1, -1, -1, -1, -1},
+    {3, 0, 8, 1, 2, 9, 2, 4, 9, 2, 6, 4, -1, -1, -1, -1},
+    {0, 2, 4, 4, 2, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {8, 3, 2, 8, 2, 4, 4, 2, 6, -1, -1, -1, -1, -1, -1, -1},
+    {10, 4, 9, 10, 6, 4, 11, 2, 3, -1, -1, -1, -1, -1, -1, -1},
+    {0, 8, 2, 2, 8, 11, 4, 9, 10, 4, 10, 6, -1, -1, -1, -1},
+    {3, 11, 2, 0, 1, 6, 0, 6, 4, 6, 1, 10, -1, -1, -1, -1},
+    {6, 4, 1, 6, 1, 10, 4, 8, 1, 2, 1, 11, 8, 11, 1, -1},
+    {9, 6, 4, 9, 3, 6, 9, 1, 3, 11, 6, 3, -1, -1, -1, -1},
+    {8, 11, 1, 8, 1, 0, 11, 6, 1, 9, 1, 4, 6, 4, 1, -1},
+    {3, 11, 6, 3, 6, 0, 0, 6, 4, -1, -1, -1, -1, -1, -1, -1},
+    {6, 4, 8, 11, 6, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {7, 10, 6, 7, 8, 10, 8, 9, 10, -1, -1, -1, -1, -1, -1, -1},
+    {0, 7, 3, 0, 10, 7, 0, 9, 10, 6, 7, 10, -1, -1, -1, -1},
+    {10, 6, 7, 1, 10, 7, 1, 7, 8, 1, 8, 0, -1, -1, -1, -1},
+    {10, 6, 7, 10, 7, 1, 1, 7, 3, -1, -1, -1, -1, -1, -1, -1},
+    {1, 2, 6, 1, 6, 8, 1, 8, 9, 8, 6, 7, -1, -1, -1, -1},
+    {2, 6, 9, 2, 9, 1, 6, 7, 9, 0, 9, 3, 7, 3, 9, -1},
+    {7, 8, 0, 7, 0, 6, 6, 0, 2, -1, -1, -1, -1, -1, -1, -1},
+    {7, 3, 2, 6, 7, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {2, 3, 11, 10, 6, 8, 10, 8, 9, 8, 6, 7, -1, -1, -1, -1},
+    {2, 0, 7, 2, 7, 11, 0, 9, 7, 6, 7, 10, 9, 10, 7, -1},
+    {1, 8, 0, 1, 7, 8, 1, 10, 7, 6, 7, 10, 2, 3, 11, -1},
+    {11, 2, 1, 11, 1, 7, 10, 6, 1, 6, 7, 1, -1, -1, -1, -1},
+    {8, 9, 6, 8, 6, 7, 9, 1, 6, 11, 6, 3, 1, 3, 6, -1},
+    {0, 9, 1, 11, 6, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {7, 8, 0, 7, 0, 6, 3, 11, 0, 11, 6, 0, -1, -1, -1, -1},
+    {7, 11, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {7, 6, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {3, 0, 8, 11, 7, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 1, 9, 11, 7, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {8, 1, 9, 8, 3, 1, 11, 7, 6, -1, -1, -1, -1, -1, -1, -1},
+    {10, 1, 2, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 2, 10, 3, 0, 8, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1},
+    {2, 9, 0, 2, 10, 9, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1},
+    {6, 11, 7, 2, 10, 3, 10, 8, 3, 10, 9, 8, -1, -1, -1, -1},
+    {7, 2, 3, 6, 2, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {7, 0, 8, 7, 6, 0, 6, 2, 0, -1, -1, -1, -1, -1, -1, -1},
+    {2, 7, 6, 2, 3, 7, 0, 1, 9, -1, -1, -1, -1, -1, -1, -1},
+    {1, 6, 2, 1, 8, 6, 1, 9, 8, 8, 7, 6, -1, -1, -1, -1},
+    {10, 7, 6, 10, 1, 7, 1, 3, 7, -1, -1, -1, -1, -1, -1, -1},
+    {10, 7, 6, 1, 7, 10, 1, 8, 7, 1, 0, 8, -1, -1, -1, -1},
+    {0, 3, 7, 0, 7, 10, 0, 10, 9, 6, 10, 7, -1, -1, -1, -1},
+    {7, 6, 10, 7, 10, 8, 8, 10, 9, -1, -1, -1, -1, -1, -1, -1},
+    {6, 8, 4, 11, 8, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {3, 6, 11, 3, 0, 6, 0, 4, 6, -1, -1, -1, -1, -1, -1, -1},
+    {8, 6, 11, 8, 4, 6, 9, 0, 1, -1, -1, -1, -1, -1, -1, -1},
+    {9, 4, 6, 9, 6, 3, 9, 3, 1, 11, 3, 6, -1, -1, -1, -1},
+    {6, 8, 4, 6, 11, 8, 2, 10, 1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 2, 10, 3, 0, 11, 0, 6, 11, 0, 4, 6, -1, -1, -1, -1},
+    {4, 11, 8, 4, 6, 11, 0, 2, 9, 2, 10, 9, -1, -1, -1, -1},
+    {10, 9, 3, 10, 3, 2, 9, 4, 3, 11, 3, 6, 4, 6, 3, -1},
+    {8, 2, 3, 8, 4, 2, 4, 6, 2, -1, -1, -1, -1, -1, -1, -1},
+    {0, 4, 2, 4, 6, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 9, 0, 2, 3, 4, 2, 4, 6, 4, 3, 8, -1, -1, -1, -1},
+    {1, 9, 4, 1, 4, 2, 2, 4, 6, -1, -1, -1, -1, -1, -1, -1},
+    {8, 1, 3, 8, 6, 1, 8, 4, 6, 6, 10, 1, -1, -1, -1, -1},
+    {10, 1, 0, 10, 0, 6, 6, 0, 4, -1, -1, -1, -1, -1, -1, -1},
+    {4, 6, 3, 4, 3, 8, 6, 10, 3, 0, 3, 9, 10, 9, 3, -1},
+    {10, 9, 4, 6, 10, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {4, 9, 5, 7, 6, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 8, 3, 4, 9, 5, 11, 7, 6, -1, -1, -1, -1, -1, -1, -1},
+    {5, 0, 1, 5, 4, 0, 7, 6, 11, -1, -1, -1, -1, -1, -1, -1},
+    {11, 7, 6, 8, 3, 4, 3, 5, 4, 3, 1, 5, -1, -1, -1, -1},
+    {9, 5, 4, 10, 1, 2, 7, 6, 11, -1, -1, -1, -1, -1, -1, -1},
+    {6, 11, 7, 1, 2, 10, 0, 8, 3, 4, 9, 5, -1, -1, -1, -1},
+    {7, 6, 11, 5, 4, 10, 4, 2, 10, 4, 0, 2, -1, -1, -1, -1},
+    {3, 4, 8, 3, 5, 4, 3, 2, 5, 10, 5, 2, 11, 7, 6, -1},
+    {7, 2, 3, 7, 6, 2, 5, 4, 9, -1, -1, -1, -1, -1, -1, -1},
+    {9, 5, 4, 0, 8, 6, 0, 6, 2, 6, 8, 7, -1, -1, -1, -1},
+    {3, 6, 2, 3, 7, 6, 1, 5, 0, 5, 4, 0, -1, -1, -1, -1},
+    {6, 2, 8, 6, 8, 7, 2, 1, 8, 4, 8, 5, 1, 5, 8, -1},
+    {9, 5, 4, 10, 1, 6, 1, 7, 6, 1, 3, 7, -1, -1, -1, -1},
+    {1, 6, 10, 1, 7, 6, 1, 0, 7, 8, 7, 0, 9, 5, 4, -1},
+    {4, 0, 10, 4, 10, 5, 0, 3, 10, 6, 10, 7, 3, 7, 10, -1},
+    {7, 6, 10, 7, 10, 8, 5, 4, 10, 4, 8, 10, -1, -1, -1, -1},
+    {6, 9, 5, 6, 11, 9, 11, 8, 9, -1, -1, -1, -1, -1, -1, -1},
+    {3, 6, 11, 0, 6, 3, 0, 5, 6, 0, 9, 5, -1, -1, -1, -1},
+    {0, 11, 8, 0, 5, 11, 0, 1, 5, 5, 6, 11, -1, -1, -1, -1},
+    {6, 11, 3, 6, 3, 5, 5, 3, 1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 2, 10, 9, 5, 11, 9, 11, 8, 11, 5, 6, -1, -1, -1, -1},
+    {0, 11, 3, 0, 6, 11, 0, 9, 6, 5, 6, 9, 1, 2, 10, -1},
+    {11, 8, 5, 11, 5, 6, 8, 0, 5, 10, 5, 2, 0, 2, 5, -1},
+    {6, 11, 3, 6, 3, 5, 2, 10, 3, 10, 5, 3, -1, -1, -1, -1},
+    {5, 8, 9, 5, 2, 8, 5, 6, 2, 3, 8, 2, -1, -1, -1, -1},
+    {9, 5, 6, 9, 6, 0, 0, 6, 2, -1, -1, -1, -1, -1, -1, -1},
+    {1, 5, 8, 1, 8, 0, 5, 6, 8, 3, 8, 2, 6, 2, 8, -1},
+    {1, 5, 6, 2, 1, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 3, 6, 1, 6, 10, 3, 8, 6, 5, 6, 9, 8, 9, 6, -1},
+    {10, 1, 0, 10, 0, 6, 9, 5, 0, 5, 6, 0, -1, -1, -1, -1},
+    {0, 3, 8, 5, 6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {10, 5, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {11, 5, 10, 7, 5, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {11, 5, 10, 11, 7, 5, 8, 3, 0, -1, -1, -1, -1, -1, -1, -1},
+    {5, 11, 7, 5, 10, 11, 1, 9, 0, -1, -1, -1, -1, -1, -1, -1},
+    {10, 7, 5, 10, 11, 7, 9, 8, 1, 8, 3, 1, -1, -1, -1, -1},
+    {11, 1, 2, 11, 7, 1, 7, 5, 1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 8, 3, 1, 2, 7, 1, 7, 5, 7, 2, 11, -1, -1, -1, -1},
+    {9, 7, 5, 9, 2, 7, 9, 0, 2, 2, 11, 7, -1, -1, -1, -1},
+    {7, 5, 2, 7, 2, 11, 5, 9, 2, 3, 2, 8, 9, 8, 2, -1},
+    {2, 5, 10, 2, 3, 5, 3, 7, 5, -1, -1, -1, -1, -1, -1, -1},
+    {8, 2, 0, 8, 5, 2, 8, 7, 5, 10, 2, 5, -1, -1, -1, -1},
+    {9, 0, 1, 5, 10, 3, 5, 3, 7, 3, 10, 2, -1, -1, -1, -1},
+    {9, 8, 2, 9, 2, 1, 8, 7, 2, 10, 2, 5, 7, 5, 2, -1},
+    {1, 3, 5, 3, 7, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 8, 7, 0, 7, 1, 1, 7, 5, -1, -1, -1, -1, -1, -1, -1},
+    {9, 0, 3, 9, 3, 5, 5, 3, 7, -1, -1, -1, -1, -1, -1, -1},
+    {9, 8, 7, 5, 9, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {5, 8, 4, 5, 10, 8, 10, 11, 8, -1, -1, -1, -1, -1, -1, -1},
+    {5, 0, 4, 5, 11, 0, 5, 10, 11, 11, 3, 0, -1, -1, -1, -1},
+    {0, 1, 9, 8, 4, 10, 8, 10, 11, 10, 4, 5, -1, -1, -1, -1},
+    {10, 11, 4, 10, 4, 5, 11, 3, 4, 9, 4, 1, 3, 1, 4, -1},
+    {2, 5, 1, 2, 8, 5, 2, 11, 8, 4, 5, 8, -1, -1, -1, -1},
+    {0, 4, 11, 0, 11, 3, 4, 5, 11, 2, 11, 1, 5, 1, 11, -1},
+    {0, 2, 5, 0, 5, 9, 2, 11, 5, 4, 5, 8, 11, 8, 5, -1},
+    {9, 4, 5, 2, 11, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {2, 5, 10, 3, 5, 2, 3, 4, 5, 3, 8, 4, -1, -1, -1, -1},
+    {5, 10, 2, 5, 2, 4, 4, 2, 0, -1, -1, -1, -1, -1, -1, -1},
+    {3, 10, 2, 3, 5, 10, 3, 8, 5, 4, 5, 8, 0, 1, 9, -1},
+    {5, 10, 2, 5, 2, 4, 1, 9, 2, 9, 4, 2, -1, -1, -1, -1},
+    {8, 4, 5, 8, 5, 3, 3, 5, 1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 4, 5, 1, 0, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {8, 4, 5, 8, 5, 3, 9, 0, 5, 0, 3, 5, -1, -1, -1, -1},
+    {9, 4, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {4, 11, 7, 4, 9, 11, 9, 10, 11, -1, -1, -1, -1, -1, -1, -1},
+    {0, 8, 3, 4, 9, 7, 9, 11, 7, 9, 10, 11, -1, -1, -1, -1},
+    {1, 10, 11, 1, 11, 4, 1, 4, 0, 7, 4, 11, -1, -1, -1, -1},
+    {3, 1, 4, 3, 4, 8, 1, 10, 4, 7, 4, 11, 10, 11, 4, -1},
+    {4, 11, 7, 9, 11, 4, 9, 2, 11, 9, 1, 2, -1, -1, -1, -1},
+    {9, 7, 4, 9, 11, 7, 9, 1, 11, 2, 11, 1, 0, 8, 3, -1},
+    {11, 7, 4, 11, 4, 2, 2, 4, 0, -1, -1, -1, -1, -1, -1, -1},
+    {11, 7, 4, 11, 4, 2, 8, 3, 4, 3, 2, 4, -1, -1, -1, -1},
+    {2, 9, 10, 2, 7, 9, 2, 3, 7, 7, 4, 9, -1, -1, -1, -1},
+    {9, 10, 7, 9, 7, 4, 10, 2, 7, 8, 7, 0, 2, 0, 7, -1},
+    {3, 7, 10, 3, 10, 2, 7, 4, 10, 1, 10, 0, 4, 0, 10, -1},
+    {1, 10, 2, 8, 7, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {4, 9, 1, 4, 1, 7, 7, 1, 3, -1, -1, -1, -1, -1, -1, -1},
+    {4, 9, 1, 4, 1, 7, 0, 8, 1, 8, 7, 1, -1, -1, -1, -1},
+    {4, 0, 3, 7, 4, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {4, 8, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {9, 10, 8, 10, 11, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {3, 0, 9, 3, 9, 11, 11, 9, 10, -1, -1, -1, -1, -1, -1, -1},
+    {0, 1, 10, 0, 10, 8, 8, 10, 11, -1, -1, -1, -1, -1, -1, -1},
+    {3, 1, 10, 11, 3, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 2, 11, 1, 11, 9, 9, 11, 8, -1, -1, -1, -1, -1, -1, -1},
+    {3, 0, 9, 3, 9, 11, 1, 2, 9, 2, 11, 9, -1, -1, -1, -1},
+    {0, 2, 11, 8, 0, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {3, 2, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {2, 3, 8, 2, 8, 10, 10, 8, 9, -1, -1, -1, -1, -1, -1, -1},
+    {9, 10, 2, 0, 9, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {2, 3, 8, 2, 8, 10, 0, 1, 8, 1, 10, 8, -1, -1, -1, -1},
+    {1, 10, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {1, 3, 8, 9, 1, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 9, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {0, 3, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+    {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}};
+
+/* Set inside[i] to 1 where values[i] < threshold, otherwise 0. NaN counts as outside,
+ * matching the scalar compare in processCell(). */
+void classifyPoints(const float *values, int count, float threshold, quint8 *inside)
+{
+    int i = 0;
+#if defined(CHEMVIEW_SSE2)
+    const __m128 t = _mm_set1_ps(threshold);
+    const __m128i one = _mm_set1_epi8(1);
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i a = _mm_castps_si128(_mm_cmplt_ps(_mm_loadu_ps(values + i), t));
+        __m128i b = _mm_castps_si128(_mm_cmplt_ps(_mm_loadu_ps(values + i + 4), t));
+        __m128i c = _mm_castps_si128(_mm_cmplt_ps(_mm_loadu_ps(values + i + 8), t));
+        __m128i d = _mm_castps_si128(_mm_cmplt_ps(_mm_loadu_ps(values + i + 12), t));
+        __m128i bytes = _mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(inside + i), _mm_and_si128(bytes, one));
+    }
+#elif defined(CHEMVIEW_NEON)
+    const float32x4_t t = vdupq_n_f32(threshold);
+    const uint8x16_t one = vdupq_n_u8(1);
+    for (; i + 16 <= count; i += 16)
+    {
+        uint16x8_t ab = vcombine_u16(vmovn_u32(vcltq_f32(vld1q_f32(values + i), t)),
+                                     vmovn_u32(vcltq_f32(vld1q_f32(values + i + 4), t)));
+        uint16x8_t cd = vcombine_u16(vmovn_u32(vcltq_f32(vld1q_f32(values + i + 8), t)),
+                                     vmovn_u32(vcltq_f32(vld1q_f32(values + i + 12), t)));
+        uint8x16_t bytes = vcombine_u8(vmovn_u16(ab), vmovn_u16(cd));
+        vst1q_u8(inside + i, vandq_u8(bytes, one));
+    }
+#endif
+    for (; i < count; i++)
+        inside[i] = values[i] < threshold;
+}
+
+/* The cube index of the cell at z between four rows of classified points, with the
+ * corners numbered as in MeshBuilder::build() */
+inline int cellCase(const quint8 *in00, const quint8 *in10, const quint8 *in11, const quint8 *in01, int z)
+{
+    return in00[z] | in10[z] << 1 | in11[z] << 2 | in01[z] << 3 |
+           in00[z + 1] << 4 | in10[z + 1] << 5 | in11[z + 1] << 6 | in01[z + 1] << 7;
+}
+
+struct Triangle {
+    std::array<int, 3> p;
+};
+
+struct TriangleMesh
+{
+    // Map the vertices to world space and generate the normals, or if the builder already
+    // generated them in grid space map those too
+    void finish(QMatrix4x4 const &transform);
+    // Drop the triangles with a vertex behind the world space plane, and the vertices
+    // no longer used by any triangle
+    void clip(QVector4D const &plane);
+
+    QVector<QVector3D> vertexList;
+    QVector<QVector3D> normalList;
+    QVector<Triangle> triangles;
+};
+
+// Central difference gradient at a grid point, one sided on the faces of the volume
+QVector3D gradientAt(const VolumeData &volume, int x, int y, int z)
+{
+    auto difference = [&volume](int x0, int y0, int z0, int x1, int y1, int z1) {
+        int span = (x1 - x0) + (y1 - y0) + (z1 - z0);
+        return span > 0 ? (volume.getAt(x1, y1, z1) - volume.getAt(x0, y0, z0)) / span : 0.0f;
+    };
+
+    return QVector3D(difference(std::max(x - 1, 0), y, z, std::min(x + 1, volume.xDim - 1), y, z),
+                     difference(x, std::max(y - 1, 0), z, x, std::min(y + 1, volume.yDim - 1), z),
+                     difference(x, y, std::max(z - 1, 0), x, y, std::min(z + 1, volume.zDim - 1)));
+}
+
+/* The normal of a vertex at mu along the edge from p1 to p2, in grid space. Points inside the
+ * surface are below the threshold, so the normal faces down the gradient of sign * value. */
+QVector3D gradientNormal(const VolumeData &volume, float sign, Point3I p1, Point3I p2, double mu)
+{
+    QVector3D g1 = gradientAt(volume, p1.x, p1.y, p1.z);
+    QVector3D g2 = gradientAt(volume, p2.x, p2.y, p2.z);
+    return -sign * (g1 + float(mu) * (g2 - g1));
+}
+
+class MeshBuilder : public TriangleMesh
+{
+public:
+    struct Gridcell {
+        std::array<Point3I, 8> p;
+        std::array<double, 8> val;
+    };
+
+    // The vertex index of each edge that has been visited, or -1. Edges along x are only
+    // shared between the cells of one x layer, edges along y and z are shared between the
+    // layers on either side of their x plane, so only the planes at x and x+1 are kept.
+    // The planes also keep their decoded and classified points.
+    struct EdgePlane {
+        QVector<int> yEdges;
+        QVector<int> zEdges;
+        QVector<float> values;
+        QVector<quint8> inside;
+    };
+
+    struct ActiveCell {
+        int z;
+        int cubeindex;
+    };
+
+    // Extract the cells with xBegin <= x < xEnd
+    void build(const VolumeData &volume, float threshold, int xBegin, int xEnd);
+    void processCell(const Gridcell &grid, double isolevel);
+    int vertexInterp(float isolevel, Point3I p1, Point3I p2, float valp1, float valp2);
+    int *edgeSlot(Point3I p1, Point3I p2);
+
+    // Add the vertices and triangles of the slab following the ones already in this builder
+    void append(MeshBuilder const &slab);
+
+    // -1 to extract the surface of the negated volume
+    float sign = 1.0f;
+    bool gradientNormals = false;
+    const VolumeData *volume = nullptr;
+    int zDim = 0;
+    int layerX = 0;
+    QVector<int> xEdges;
+    EdgePlane lowerPlane;
+    EdgePlane upperPlane;
+
+    // The vertices on the planes at xBegin and xEnd, which are shared with the neighboring
+    // slabs. Edges are numbered 2 * (y * zDim + z), plus one for edges along z.
+    struct EdgeVertex {
+        int edge;
+        int index;
+    };
+    QVector<EdgeVertex> firstVertices;
+    QVector<EdgeVertex> lastVertices;
+    static QVector<EdgeVertex> planeVertices(EdgePlane const &plane);
+
+private:
+    void loadPlane(const VolumeData &volume, float threshold, int x, EdgePlane &plane);
+};
+
+void MeshBuilder::build(const VolumeData &volume, float threshold, int xBegin, int xEnd)
+{
+    // Skip over bricks that don't contain any cells the surface passes through
+    auto const &bricks = volume.brickIndex();
+    const int brickSize = VolumeData::BrickIndex::brickSize;
+
+    const int planeSize = volume.yDim * volume.zDim;
+    const int yDim = volume.yDim;
+    zDim = volume.zDim;
+    this->volume = &volume;
+    upperPlane.yEdges.fill(-1, planeSize);
+    upperPlane.zEdges.fill(-1, planeSize);
+    if (xBegin < xEnd)
+        loadPlane(volume, threshold, xBegin, upperPlane);
+
+    QVector<ActiveCell> activeCells;
+    activeCells.reserve(zDim);
+
+    for (int x = xBegin; x < xEnd; x++)
+    {
+        // The upper plane of the previous layer is the lower plane of this one
+        layerX = x;
+        std::swap(lowerPlane, upperPlane);
+        upperPlane.yEdges.fill(-1, planeSize);
+        upperPlane.zEdges.fill(-1, planeSize);
+        xEdges.fill(-1, planeSize);
+        loadPlane(volume, threshold, x + 1, upperPlane);
+
+        for (int y = 0; y < yDim - 1; y++)
+        {
+            const quint8 *in00 = lowerPlane.inside.constData() + y * zDim;
+            const quint8 *in01 = in00 + zDim;
+            const quint8 *in10 = upperPlane.inside.constData() + y * zDim;
+            const quint8 *in11 = in10 + zDim;
+
+            // Find the cells the surface passes through before triangulating any of them
+            activeCells.clear();
+            for (int brickZ = 0; brickZ < zDim - 1; brickZ += brickSize)
+            {
+                int brick = bricks.offset(x / brickSize, y / brickSize, brickZ / brickSize);
+                if (sign > 0.0f ? !bricks.mayCross(brick, threshold)
+                                : !(bricks.maxValues[brick] > -threshold && bricks.minValues[brick] <= -threshold))
+                    continue;
+
+                int brickEnd = std::min(brickZ + brickSize, zDim - 1);
+                for (int z = brickZ; z < brickEnd; z++)
+                {
+                    int cubeindex = cellCase(in00, in10, in11, in01, z);
+                    if (cubeindex != 0 && cubeindex != 255)
+                        activeCells.push_back({z, cubeindex});
+                }
+            }
+
+            const float *v00 = lowerPlane.values.constData() + y * zDim;
+            const float *v01 = v00 + zDim;
+            const float *v10 = upperPlane.values.constData() + y * zDim;
+            const float *v11 = v10 + zDim;
+
+            for (auto const &cell: activeCells)
+            {
+                int z = cell.z;
+                Gridcell grid;
+                grid.p[0] = Point3I(x,   y,   z);
+                grid.p[1] = Point3I(x+1, y,   z);
+                grid.p[2] = Point3I(x+1, y+1, z);
+                grid.p[3] = Point3I(x,   y+1, z);
+                grid.p[4] = Point3I(x,   y,   z+1);
+                grid.p[5] = Point3I(x+1, y,   z+1);
+                grid.p[6] = Point3I(x+1, y+1, z+1);
+                grid.p[7] = Point3I(x,   y+1, z+1);
+
+                grid.val[0] = v00[z];
+                grid.val[1] = v10[z];
+                grid.val[2] = v11[z];
+                grid.val[3] = v01[z];
+                grid.val[4] = v00[z+1];
+                grid.val[5] = v10[z+1];
+                grid.val[6] = v11[z+1];
+                grid.val[7] = v01[z+1];
+
+                processCell(grid, threshold);
+            }
+        }
+
+        if (x == xBegin)
+            firstVertices = planeVertices(lowerPlane);
+    }
+
+    // Only the shared vertices are needed to merge the slabs, drop the rest of the cache
+    lastVertices = planeVertices(upperPlane);
+    xEdges = {};
+    lowerPlane = {};
+    upperPlane = {};
+}
+
+void MeshBuilder::loadPlane(const VolumeData &volume, float threshold, int x, EdgePlane &plane)
+{
+    const int planeSize = volume.yDim * volume.zDim;
+    plane.values.resize(planeSize);
+    plane.inside.resize(planeSize);
+    volume.getValues(x * planeSize, planeSize, plane.values.data());
+    if (sign < 0.0f)
+        for (auto &v: plane.values)
+            v = -v;
+    classifyPoints(plane.values.constData(), planeSize, threshold, plane.inside.data());
+}
+
+QVector<MeshBuilder::EdgeVertex> MeshBuilder::planeVertices(EdgePlane const &plane)
+{
+    QVector<EdgeVertex> result;
+    for (int i = 0; i < plane.yEdges.size(); ++i)
+    {
+        if (plane.yEdges[i] != -1)
+            result.push_back({2 * i, plane.yEdges[i]});
+        if (plane.zEdges[i] != -1)
+            result.push_back({2 * i + 1, plane.zEdges[i]});
+    }
+    return result;
+}
+
+/* Cells are visited in the same order as a single builder would, so a vertex on the plane
+ * between two slabs is first created by the last layer of the earlier slab. The later slab's
+ * copy is dropped and its triangles are remapped to the existing vertex, which makes the
+ * result identical to building the whole volume at once. */
+void MeshBuilder::append(MeshBuilder const &slab)
+{
+    QHash<int, int> sharedVertices;
+    for (auto const &v: lastVertices)
+        sharedVertices[v.edge] = v.index;
+
+    QVector<int> remap(slab.vertexList.size(), -1);
+    for (auto const &v: slab.firstVertices)
+        remap[v.index] = sharedVertices.value(v.edge, -1);
+
+    for (int i = 0; i < slab.vertexList.size(); ++i)
+    {
+        if (remap[i] == -1)
+        {
+            remap[i] = vertexList.size();
+            vertexList.push_back(slab.vertexList[i]);
+            if (!slab.normalList.isEmpty())
+                normalList.push_back(slab.normalList[i]);
+        }
+    }
+
+    for (auto const &triangle: slab.triangles)
+    {
+        Triangle t;
+        t.p[0] = remap[triangle.p[0]];
+        t.p[1] = remap[triangle.p[1]];
+        t.p[2] = remap[triangle.p[2]];
+        triangles.push_back(t);
+    }
+
+    // Keep the slab's last plane, in merged indices, for the next one
+    lastVertices = slab.lastVertices;
+    for (auto &v: lastVertices)
+        v.index = remap[v.index];
+}
+
+void TriangleMesh::finish(QMatrix4x4 const &transform)
+{
+    for (auto &coord: vertexList)
+        coord = transform.map(coord);
+
+    if (!normalList.isEmpty())
+    {
+        QMatrix3x3 normalMatrix = transform.normalMatrix();
+        for (auto &normal: normalList)
+        {
+            normal = QVector3D(normalMatrix(0, 0) * normal.x() + normalMatrix(0, 1) * normal.y() + normalMatrix(0, 2) * normal.z(),
+                               normalMatrix(1, 0) * normal.x() + normalMatrix(1, 1) * normal.y() + normalMatrix(1, 2) * normal.z(),
+                               normalMatrix(2, 0) * normal.x() + normalMatrix(2, 1) * normal.y() + normalMatrix(2, 2) * normal.z());
+            normal.normalize();
+        }
+        return;
+    }
+
+    // Generate smooth vertex normals by averaging the face normals of
+    // all triangles sharing the vertex.
+    // TODO: The original source of this code mentions doing a weighted
+    //       average based on the size of the trangle my provide better
+    //       results.
+    normalList.resize(vertexList.size());
+    for (auto &triangle: triangles)
+    {
+        auto p0 = vertexList[triangle.p[0]];
+        auto p1 = vertexList[triangle.p[1]];
+        auto p2 = vertexList[triangle.p[2]];
+
+        QVector3D surfaceNormal = QVector3D::normal(p1 - p0, p2 - p0);
+        normalList[triangle.p[0]] += surfaceNormal;
+        normalList[triangle.p[1]] += surfaceNormal;
+        normalList[triangle.p[2]] += surfaceNormal;
+    }
+
+    for (auto &normal: normalList)
+        normal.normalize();
+}
+
+void TriangleMesh::clip(QVector4D const &plane)
+{
+    QVector<int> remap(vertexList.size(), -1);
+    for (int i = 0; i < vertexList.size(); ++i)
+        if (QVector4D::dotProduct(plane, QVector4D(vertexList[i], 1.0f)) >= 0.0f)
+            remap[i] = 0;
+
+    QVector<Triangle> kept;
+    for (auto const &triangle: triangles)
+        if (remap[triangle.p[0]] >= 0 && remap[triangle.p[1]] >= 0 && remap[triangle.p[2]] >= 0)
+            kept.push_back(triangle);
+
+    // Number the vertices still in use in their original order
+    std::fill(remap.begin(), remap.end(), -1);
+    for (auto const &triangle: kept)
+        for (int p: triangle.p)
+            remap[p] = 0;
+    int next = 0;
+    for (int i = 0; i < vertexList.size(); ++i)
+    {
+        if (remap[i] < 0)
+            continue;
+        remap[i] = next;
+        vertexList[next] = vertexList[i];
+        normalList[next] = normalList[i];
+        next++;
+    }
+    vertexList.resize(next);
+    normalList.resize(next);
+
+    for (auto &triangle: kept)
+        for (int &p: triangle.p)
+            p = remap[p];
+    triangles = kept;
+}
+
+/* Given a grid cell and an isolevel, calculate the triangular
+ * facets required to represent the isosurface through the cell. */
+void MeshBuilder::processCell(Gridcell const &grid, double isolevel)
+{
+    int cubeindex = 0;
+    int vertlist[12];
+   /* Determine the index into the edge table which
+      tells us which vertices are inside of the surface */
+   if (grid.val[0] < isolevel) cubeindex |= 1;
+   if (grid.val[1] < isolevel) cubeindex |= 2;
+   if (grid.val[2] < isolevel) cubeindex |= 4;
+   if (grid.val[3] < isolevel) cubeindex |= 8;
+   if (grid.val[4] < isolevel) cubeindex |= 16;
+   if (grid.val[5] < isolevel) cubeindex |= 32;
+   if (grid.val[6] < isolevel) cubeindex |= 64;
+   if (grid.val[7] < isolevel) cubeindex |= 128;
+
+   /* Cube is entirely in/out of the surface */
+   if (edgeTable[cubeindex] == 0)
+      return;
+
+   /* Find the vertices where the surface intersects the cube */
+   if (edgeTable[cubeindex] & 1)
+      vertlist[0]  = vertexInterp(isolevel, grid.p[0], grid.p[1], grid.val[0], grid.val[1]);
+   if (edgeTable[cubeindex] & 2)
+      vertlist[1]  = vertexInterp(isolevel, grid.p[1], grid.p[2], grid.val[1], grid.val[2]);
+   if (edgeTable[cubeindex] & 4)
+      vertlist[2]  = vertexInterp(isolevel, grid.p[2], grid.p[3], grid.val[2], grid.val[3]);
+   if (edgeTable[cubeindex] & 8)
+      vertlist[3]  = vertexInterp(isolevel, grid.p[3], grid.p[0], grid.val[3], grid.val[0]);
+   if (edgeTable[cubeindex] & 16)
+      vertlist[4]  = vertexInterp(isolevel, grid.p[4], grid.p[5], grid.val[4], grid.val[5]);
+   if (edgeTable[cubeindex] & 32)
+      vertlist[5]  = vertexInterp(isolevel, grid.p[5], grid.p[6], grid.val[5], grid.val[6]);
+   if (edgeTable[cubeindex] & 64)
+      vertlist[6]  = vertexInterp(isolevel, grid.p[6], grid.p[7], grid.val[6], grid.val[7]);
+   if (edgeTable[cubeindex] & 128)
+      vertlist[7]  = vertexInterp(isolevel, grid.p[7], grid.p[4], grid.val[7], grid.val[4]);
+   if (edgeTable[cubeindex] & 256)
+      vertlist[8]  = vertexInterp(isolevel, grid.p[0], grid.p[4], grid.val[0], grid.val[4]);
+   if (edgeTable[cubeindex] & 512)
+      vertlist[9]  = vertexInterp(isolevel, grid.p[1], grid.p[5], grid.val[1], grid.val[5]);
+   if (edgeTable[cubeindex] & 1024)
+      vertlist[10] = vertexInterp(isolevel, grid.p[2], grid.p[6], grid.val[2], grid.val[6]);
+   if (edgeTable[cubeindex] & 2048)
+      vertlist[11] = vertexInterp(isolevel, grid.p[3], grid.p[7], grid.val[3], grid.val[7]);
+
+    /* Create the triangles */
+    for (int i = 0; triTable[cubeindex][i] != -1; i += 3)
+    {
+        Triangle t;
+        t.p[0] = vertlist[triTable[cubeindex][i  ]];
+        t.p[1] = vertlist[triTable[cubeindex][i+1]];
+        t.p[2] = vertlist[triTable[cubeindex][i+2]];
+        triangles.push_back(t);
+    }
+}
+
+/* Linearly interpolate the position where an isosurface cuts
+ * an edge between two vertices, each with their own scalar value */
+int MeshBuilder::vertexInterp(float isolevel, Point3I p1, Point3I p2, float valp1, float valp2)
+{
+    int *slot = edgeSlot(p1, p2);
+    if (*slot != -1)
+        return *slot;
+
+    QVector3D value;
+    double mu;
+
+    if (std::abs(isolevel-valp1) < 0.00001)
+        value = p1.toQVector3D();
+    if (std::abs(isolevel-valp2) < 0.00001)
+        value = p2.toQVector3D();
+    if (std::abs(valp1-valp2) < 0.00001)
+        value = p1.toQVector3D();
+    mu = (isolevel - valp1) / (valp2 - valp1);
+    value = QVector3D(p1.x + mu * (p2.x - p1.x),
+                      p1.y + mu * (p2.y - p1.y),
+                      p1.z + mu * (p2.z - p1.z));
+
+    *slot = vertexList.size();
+    vertexList.push_back(value);
+    if (gradientNormals)
+        normalList.push_back(gradientNormal(*volume, sign, p1, p2, mu));
+
+    return *slot;
+}
+
+/* The cache entry for the edge between two adjacent grid points */
+int *MeshBuilder::edgeSlot(Point3I p1, Point3I p2)
+{
+    int offset = std::min(p1.y, p2.y) * zDim + std::min(p1.z, p2.z);
+    if (p1.x != p2.x)
+        return &xEdges[offset];
+
+    EdgePlane &plane = p1.x == layerX ? lowerPlane : upperPlane;
+    if (p1.y != p2.y)
+        return &plane.yEdges[offset];
+    return &plane.zEdges[offset];
+}
+
+} // namespace
+/* End marching cubes code */
+
+namespace {
+
+// Reports IsosurfaceOptions::progress as the slices of the volume are processed,
+// and checks IsosurfaceOptions::cancel between them
+class Progress
+{
+public:
+    Progress(IsosurfaceOptions const &options, int total) : options(options), total(std::max(total, 1)) {}
+
+    // Count one more slice as done, false if the build has been cancelled
+    bool step()
+    {
+        if (options.progress)
+        {
+            int percent = int(qint64(++done) * 100 / total);
+            int last = reported.load();
+            while (percent > last && !reported.compare_exchange_weak(last, percent)) {}
+            if (percent > last)
+                options.progress(percent);
+        }
+        return !cancelled();
+    }
+
+    bool cancelled() const
+    {
+        return options.cancel && *options.cancel;
+    }
+
+private:
+    IsosurfaceOptions const &options;
+    const int total;
+    std::atomic<int> done {0};
+    std::atomic<int> reported {0};
+};
+
+// Call fn(i) for each 0 <= i < count on up to threadCount threads, 0 for one per core.
+// Each call counts as one step of progress, no more are started once it's cancelled.
+template <typename Function>
+void parallelFor(int count, int threadCount, Progress &progress, Function fn)
+{
+    if (threadCount <= 0)
+        threadCount = QThread::idealThreadCount();
+    threadCount = std::min(threadCount, count);
+
+    std::atomic<int> next(0);
+    auto work = [&]() {
+        for (int i = next++; i < count; i = next++)
+        {
+            fn(i);
+            if (!progress.step())
+                next = count;
+        }
+    };
+
+    // This thread also does work, so a full pool can't stall the loop
+    QList<QFuture<void>> workers;
+    for (int i = 1; i < threadCount; ++i)
+        workers.push_back(QtConcurrent::run(QThreadPool::globalInstance(), work));
+    work();
+    for (auto &worker: workers)
+        worker.waitForFinished();
+}
+
+// The slabs don't depend on the thread count, and merging them in order gives the
+// same mesh as a single slab would.
+const int slabWidth = 4;
+
+int marchingCubesSlabCount(const VolumeData &volume)
+{
+    const int cellsX = std::max(volume.xDim - 1, 0);
+    return (cellsX + slabWidth - 1) / slabWidth;
+}
+
+void buildMarchingCubes(const VolumeData &volume, float sign, float threshold, IsosurfaceOptions const &options, Progress &progress, TriangleMesh &mesh)
+{
+    const int cellsX = std::max(volume.xDim - 1, 0);
+    const int slabCount = marchingCubesSlabCount(volume);
+
+    std::vector<MeshBuilder> slabs(slabCount);
+    parallelFor(slabCount, options.threadCount, progress, [&](int i) {
+        slabs[i].sign = sign;
+        slabs[i].gradientNormals = options.normals == IsosurfaceOptions::Normals::Gradient;
+        slabs[i].build(volume, threshold, i * slabWidth, std::min((i + 1) * slabWidth, cellsX));
+    });
+
+    if (progress.cancelled())
+        return;
+
+    MeshBuilder builder;
+    builder.sign = sign;
+    for (auto const &slab: slabs)
+        builder.append(slab);
+    mesh = std::move(builder);
+}
+
+/* Flying Edges, after Schroeder, Maynard & Geveci, "Flying Edges: A High-Performance Scalable
+ * Isocontouring Algorithm" (2015). The volume is processed in rows along z, its contiguous axis:
+ *  1. Classify each point and find where the z edges of each row cross the surface.
+ *  2. Count the crossing x and y edges that start in each row, trim each row of cells to the
+ *     range that can contain the surface, and count the triangles in that range.
+ *  3. Turn the counts into offsets so the output can be allocated at its final size.
+ *  4. Write the vertices and triangles of each row of cells directly into the output.
+ * The cases come from the same tables as MeshBuilder, so the triangles are the same and in
+ * the same order, only the numbering of the vertices differs.
+ *
+ * Several surfaces of the same volume can be extracted together, each row is only decoded
+ * once and then classified for every surface. A surface with sign -1 is extracted from the
+ * negated values, which gives the negative lobe of an orbital with outward facing triangles. */
+class FlyingEdges
+{
+public:
+    explicit FlyingEdges(bool gradientNormals = false) : gradientNormals(gradientNormals) {}
+
+    void addSurface(float sign, TriangleMesh *mesh);
+    void build(const VolumeData &volume, float threshold, int threadCount, Progress &progress);
+    // The number of progress steps build() takes
+    int stepCount(const VolumeData &volume) const;
+
+private:
+    struct Row {
+        // The first and last z edges that cross the surface, first > last if there are none
+        int first;
+        int last;
+        // The number of crossing edges that start at the points of this row
+        int xCount;
+        int yCount;
+        int zCount;
+        int vertexOffset;
+    };
+
+    struct CellRow {
+        // Cells outside [begin, end) can't contain the surface
+        int begin;
+        int end;
+        int triangleCount;
+        int triangleOffset;
+    };
+
+    struct Surface {
+        float sign;
+        TriangleMesh *mesh;
+        // 1 for points below the threshold, in the same layout as the volume
+        std::vector<quint8> inside;
+        // 1 for the bricks the surface may pass through, the points of the others are all
+        // on the same side so they don't need to be decoded
+        std::vector<quint8> activeBricks;
+        std::vector<Row> rows;
+        std::vector<CellRow> cellRows;
+
+        const quint8 *rowInside(int row, int zDim) const
+        {
+            return inside.data() + qint64(row) * zDim;
+        }
+    };
+
+    void classifyRow(int x, int y);
+    void countRow(Surface &surface, int x, int y) const;
+    void allocate(Surface &surface) const;
+    void generateCellRow(Surface const &surface, int x, int y, QVector3D *vertices, QVector3D *normals, Triangle *triangles) const;
+    void trim(Surface const &surface, std::initializer_list<int> rowIds, int &begin, int &end) const;
+    int crossings(Surface const &surface, int rowA, int rowB) const;
+    // Also writes the vertex's normal when normal isn't null
+    QVector3D interpolate(float sign, Point3I p1, Point3I p2, QVector3D *normal) const;
+
+    const bool gradientNormals;
+
+    const VolumeData *volume = nullptr;
+    const VolumeData::BrickIndex *bricks = nullptr;
+    float threshold = 0.0f;
+    int xDim = 0;
+    int yDim = 0;
+    int zDim = 0;
+    std::vector<Surface> surfaces;
+};
+
+std::array<int, 256> const &triangleCounts()
+{
+    static const std::array<int, 256> counts = []() {
+        std::array<int, 256> result;
+        for (int i = 0; i < 256; ++i)
+        {
+            int count = 0;
+            while (triTable[i][count] != -1)
+                count++;
+            result[i] = count / 3;
+        }
+        return result;
+    }();
+    return counts;
+}
+
+void FlyingEdges::addSurface(float sign, TriangleMesh *mesh)
+{
+    Surface surface;
+    surface.sign = sign;
+    surface.mesh = mesh;
+    surfaces.push_back(std::move(surface));
+}
+
+int FlyingEdges::stepCount(const VolumeData &volume) const
+{
+    // Each surface needs two passes after they're all classified together
+    return volume.xDim + int(surfaces.size()) * (2 * volume.xDim - 1);
+}
+
+void FlyingEdges::build(const VolumeData &volume, float threshold, int threadCount, Progress &progress)
+{
+    if (volume.xDim < 2 || volume.yDim < 2 || volume.zDim < 2)
+        return;
+
+    this->volume = &volume;
+    this->threshold = threshold;
+    xDim = volume.xDim;
+    yDim = volume.yDim;
+    zDim = volume.zDim;
+    bricks = &volume.brickIndex();
+    for (auto &surface: surfaces)
+    {
+        surface.activeBricks.assign(bricks->minValues.size(), 0);
+        for (int brick: bricks->activeBricks(threshold, surface.sign))
+            surface.activeBricks[brick] = 1;
+
+        surface.inside.resize(size_t(volume.size()));
+        surface.rows.resize(size_t(xDim) * yDim);
+        surface.cellRows.resize(size_t(xDim - 1) * (yDim - 1));
+    }
+
+    // The later passes depend on all of the earlier one, so stop as soon as one is cancelled
+    parallelFor(xDim, threadCount, progress, [this](int x) {
+        for (int y = 0; y < yDim; y++)
+            classifyRow(x, y);
+    });
+    if (progress.cancelled())
+        return;
+
+    for (auto &surface: surfaces)
+    {
+        parallelFor(xDim, threadCount, progress, [this, &surface](int x) {
+            for (int y = 0; y < yDim; y++)
+                countRow(surface, x, y);
+        });
+        if (progress.cancelled())
+            return;
+
+        allocate(surface);
+        QVector3D *vertices = surface.mesh->vertexList.data();
+        QVector3D *normals = gradientNormals ? surface.mesh->normalList.data() : nullptr;
+        Triangle *triangles = surface.mesh->triangles.data();
+
+        parallelFor(xDim - 1, threadCount, progress, [this, &surface, vertices, normals, triangles](int x) {
+            for (int y = 0; y < yDim - 1; y++)
+                generateCellRow(surface, x, y, vertices, normals, triangles);
+        });
+        if (progress.cancelled())
+            return;
+    }
+}
+
+/* The row is split into the points of each brick along z. The z edges of an inactive brick
+ * can't cross the surface, so only the active bricks need to be decoded and searched. */
+void FlyingEdges::classifyRow(int x, int y)
+{
+    const int row = x * yDim + y;
+    const int brickSize = VolumeData::BrickIndex::brickSize;
+    std::vector<float> values(zDim);
+    std::vector<float> negated;
+
+    auto segment = [&](int bz, int &zBegin, int &zEnd) {
+        zBegin = bz * brickSize;
+        zEnd = bz == bricks->zBricks - 1 ? zDim : zBegin + brickSize;
+        return bricks->pointOffset(x, y, zBegin);
+    };
+
+    int zBegin, zEnd;
+    for (int bz = 0; bz < bricks->zBricks; bz++)
+    {
+        int brick = segment(bz, zBegin, zEnd);
+        for (auto const &surface: surfaces)
+        {
+            if (surface.activeBricks[brick])
+            {
+                volume->getValues(row * zDim + zBegin, zEnd - zBegin, values.data() + zBegin);
+                break;
+            }
+        }
+    }
+
+    for (auto &surface: surfaces)
+    {
+        const float *surfaceValues = values.data();
+        if (surface.sign < 0.0f)
+        {
+            negated.resize(zDim);
+            for (int z = 0; z < zDim; z++)
+                negated[z] = -values[z];
+            surfaceValues = negated.data();
+        }
+
+        quint8 *in = surface.inside.data() + qint64(row) * zDim;
+        Row &r = surface.rows[row];
+        r.first = zDim;
+        r.last = -1;
+        r.zCount = 0;
+
+        for (int bz = 0; bz < bricks->zBricks; bz++)
+        {
+            int brick = segment(bz, zBegin, zEnd);
+            if (surface.activeBricks[brick])
+                classifyPoints(surfaceValues + zBegin, zEnd - zBegin, threshold, in + zBegin);
+            else
+                std::fill(in + zBegin, in + zEnd, quint8(bricks->allInside(brick, threshold, surface.sign)));
+        }
+
+        // The last edge of a brick ends on the first point of the next one
+        for (int bz = 0; bz < bricks->zBricks; bz++)
+        {
+            int brick = segment(bz, zBegin, zEnd);
+            if (!surface.activeBricks[brick])
+                continue;
+
+            for (int z = zBegin; z < std::min(zEnd, zDim - 1); z++)
+            {
+                if (in[z] != in[z + 1])
+                {
+                    r.first = std::min(r.first, z);
+                    r.last = z;
+                    r.zCount++;
+                }
+            }
+        }
+    }
+}
+
+/* The range of cells [begin, end) along z that may contain the surface, given the rows at
+ * their corners. Before the first and after the last crossing z edge each row is constant,
+ * so the x and y edges there only cross if the rows differ at the ends of the range. */
+void FlyingEdges::trim(Surface const &surface, std::initializer_list<int> rowIds, int &begin, int &end) const
+{
+    int first = zDim;
+    int last = -1;
+    for (int row: rowIds)
+    {
+        first = std::min(first, surface.rows[row].first);
+        last = std::max(last, surface.rows[row].last);
+    }
+
+    begin = first <= last ? first : 0;
+    end = first <= last ? last + 1 : 0;
+
+    auto differ = [&](int z) {
+        quint8 value = surface.rowInside(*rowIds.begin(), zDim)[z];
+        for (int row: rowIds)
+            if (surface.rowInside(row, zDim)[z] != value)
+                return true;
+        return false;
+    };
+
+    if (differ(begin))
+        begin = 0;
+    if (differ(end))
+        end = zDim - 1;
+}
+
+// The number of edges between two rows that cross the surface
+int FlyingEdges::crossings(Surface const &surface, int rowA, int rowB) const
+{
+    int begin, end;
+    trim(surface, {rowA, rowB}, begin, end);
+
+    const quint8 *inA = surface.rowInside(rowA, zDim);
+    const quint8 *inB = surface.rowInside(rowB, zDim);
+    int count = 0;
+    for (int z = begin; z <= end; z++)
+        count += inA[z] != inB[z];
+    return count;
+}
+
+void FlyingEdges::countRow(Surface &surface, int x, int y) const
+{
+    const int row = x * yDim + y;
+    Row &r = surface.rows[row];
+    r.xCount = x < xDim - 1 ? crossings(surface, row, row + yDim) : 0;
+    r.yCount = y < yDim - 1 ? crossings(surface, row, row + 1) : 0;
+
+    if (x < xDim - 1 && y < yDim - 1)
+    {
+        CellRow &cellRow = surface.cellRows[x * (yDim - 1) + y];
+        trim(surface, {row, row + yDim, row + yDim + 1, row + 1}, cellRow.begin, cellRow.end);
+
+        const quint8 *in00 = surface.rowInside(row, zDim);
+        const quint8 *in10 = surface.rowInside(row + yDim, zDim);
+        const quint8 *in11 = surface.rowInside(row + yDim + 1, zDim);
+        const quint8 *in01 = surface.rowInside(row + 1, zDim);
+        auto const &counts = triangleCounts();
+        cellRow.triangleCount = 0;
+        for (int z = cellRow.begin; z < cellRow.end; z++)
+            cellRow.triangleCount += counts[cellCase(in00, in10, in11, in01, z)];
+    }
+}
+
+void FlyingEdges::allocate(Surface &surface) const
+{
+    int vertexCount = 0;
+    for (auto &row: surface.rows)
+    {
+        row.vertexOffset = vertexCount;
+        vertexCount += row.xCount + row.yCount + row.zCount;
+    }
+
+    int triangleCount = 0;
+    for (auto &cellRow: surface.cellRows)
+    {
+        cellRow.triangleOffset = triangleCount;
+        triangleCount += cellRow.triangleCount;
+    }
+
+    surface.mesh->vertexList.resize(vertexCount);
+    if (gradientNormals)
+        surface.mesh->normalList.resize(vertexCount);
+    surface.mesh->triangles.resize(triangleCount);
+}
+
+QVector3D FlyingEdges::interpolate(float sign, Point3I p1, Point3I p2, QVector3D *normal) const
+{
+    float valp1 = sign * volume->getAt(p1.x, p1.y, p1.z);
+    float valp2 = sign * volume->getAt(p2.x, p2.y, p2.z);
+    double mu = (threshold - valp1) / (valp2 - valp1);
+    if (normal)
+        *normal = gradientNormal(*volume, sign, p1, p2, mu);
+    return QVector3D(p1.x + mu * (p2.x - p1.x),
+                     p1.y + mu * (p2.y - p1.y),
+                     p1.z + mu * (p2.z - p1.z));
+}
+
+/* Each row owns the vertices on the edges that start at its points, a vertex's index is
+ * the row's offset plus the number of crossing edges of the same kind before it. Rows on
+ * the upper x and y faces have no cells of their own, so their vertices are written by
+ * the adjacent row of cells. */
+void FlyingEdges::generateCellRow(Surface const &surface, int x, int y, QVector3D *vertices, QVector3D *normals, Triangle *triangles) const
+{
+    CellRow const &cellRow = surface.cellRows[x * (yDim - 1) + y];
+    if (cellRow.begin >= cellRow.end)
+        return;
+
+    const int row00 = x * yDim + y;
+    const int row10 = row00 + yDim;
+    const int row11 = row00 + yDim + 1;
+    const int row01 = row00 + 1;
+    const quint8 *in00 = surface.rowInside(row00, zDim);
+    const quint8 *in10 = surface.rowInside(row10, zDim);
+    const quint8 *in11 = surface.rowInside(row11, zDim);
+    const quint8 *in01 = surface.rowInside(row01, zDim);
+    auto const &rows = surface.rows;
+
+    const bool write10 = x == xDim - 2;
+    const bool write01 = y == yDim - 2;
+    const bool write11 = write10 && write01;
+
+    // The next index for each kind of edge in each row
+    int x00 = rows[row00].vertexOffset;
+    int y00 = x00 + rows[row00].xCount;
+    int z00 = y00 + rows[row00].yCount;
+    int y10 = rows[row10].vertexOffset + rows[row10].xCount;
+    int z10 = y10 + rows[row10].yCount;
+    int x01 = rows[row01].vertexOffset;
+    int z01 = x01 + rows[row01].xCount + rows[row01].yCount;
+    int z11 = rows[row11].vertexOffset + rows[row11].xCount + rows[row11].yCount;
+
+    auto addVertex = [&](int &next, bool write, Point3I p1, Point3I p2) {
+        int index = next++;
+        if (write)
+            vertices[index] = interpolate(surface.sign, p1, p2, normals ? normals + index : nullptr);
+        return index;
+    };
+
+    // The x and y edges at a point, in the order of cell edges 0-3 (or 4-7 for the upper points)
+    auto pointEdges = [&](int z, int edges[4]) {
+        edges[0] = in00[z] != in10[z] ? addVertex(x00, true, Point3I(x, y, z), Point3I(x+1, y, z)) : -1;
+        edges[1] = in10[z] != in11[z] ? addVertex(y10, write10, Point3I(x+1, y, z), Point3I(x+1, y+1, z)) : -1;
+        edges[2] = in01[z] != in11[z] ? addVertex(x01, write01, Point3I(x, y+1, z), Point3I(x+1, y+1, z)) : -1;
+        edges[3] = in00[z] != in01[z] ? addVertex(y00, true, Point3I(x, y, z), Point3I(x, y+1, z)) : -1;
+    };
+
+    int vertlist[12];
+    pointEdges(cellRow.begin, vertlist);
+
+    Triangle *out = triangles + cellRow.triangleOffset;
+    for (int z = cellRow.begin; z < cellRow.end; z++)
+    {
+        pointEdges(z + 1, vertlist + 4);
+        vertlist[8]  = in00[z] != in00[z + 1] ? addVertex(z00, true, Point3I(x, y, z), Point3I(x, y, z+1)) : -1;
+        vertlist[9]  = in10[z] != in10[z + 1] ? addVertex(z10, write10, Point3I(x+1, y, z), Point3I(x+1, y, z+1)) : -1;
+        vertlist[10] = in11[z] != in11[z + 1] ? addVertex(z11, write11, Point3I(x+1, y+1, z), Point3I(x+1, y+1, z+1)) : -1;
+        vertlist[11] = in01[z] != in01[z + 1] ? addVertex(z01, write01, Point3I(x, y+1, z), Point3I(x, y+1, z+1)) : -1;
+
+        int cubeindex = cellCase(in00, in10, in11, in01, z);
+        for (int i = 0; triTable[cubeindex][i] != -1; i += 3)
+        {
+            out->p[0] = vertlist[triTable[cubeindex][i  ]];
+            out->p[1] = vertlist[triTable[cubeindex][i+1]];
+            out->p[2] = vertlist[triTable[cubeindex][i+2]];
+            out++;
+        }
+
+        std::copy(vertlist + 4, vertlist + 8, vertlist);
+    }
+}
+
+/* Quadric error decimation, after Garland & Heckbert, "Surface Simplification Using Quadric
+ * Error Metrics" (1997). Edges are collapsed in order of the summed squared distance from the
+ * merged vertex to the planes of the original triangles around it. Collapses that would change
+ * the topology are skipped: edges failing the link condition, ones that would leave less than
+ * a tetrahedron, and ones touching the boundary where the surface meets the edge of the volume.
+ * So are collapses that would flip a triangle. */
+class Decimator
+{
+public:
+    explicit Decimator(TriangleMesh &mesh);
+
+    // Collapse edges until at most targetTriangles remain (0 for no limit), skipping collapses
+    // whose merged vertex would be further than maxError from the original planes around it,
+    // as a root mean square distance
+    void run(int targetTriangles, float maxError, std::atomic<bool> const *cancel);
+
+private:
+    struct Quadric {
+        // The upper triangle of the symmetric 4x4 matrix
+        double q[10] = {};
+        // The number of planes summed, error() / planes is the mean squared distance to them
+        double planes = 0.0;
+
+        static Quadric plane(QVector3D n, double d)
+        {
+            double a = n.x(), b = n.y(), c = n.z();
+            return {{a*a, a*b, a*c, a*d, b*b, b*c, b*d, c*c, c*d, d*d}, 1.0};
+        }
+
+        Quadric &operator+=(Quadric const &other)
+        {
+            for (int i = 0; i < 10; ++i)
+                q[i] += other.q[i];
+            planes += other.planes;
+            return *this;
+        }
+
+        double error(QVector3D v) const
+        {
+            double x = v.x(), y = v.y(), z = v.z();
+            return q[0]*x*x + 2*q[1]*x*y + 2*q[2]*x*z + 2*q[3]*x
+                 + q[4]*y*y + 2*q[5]*y*z + 2*q[6]*y
+                 + q[7]*z*z + 2*q[8]*z
+                 + q[9];
+        }
+
+        // The point with the least error, false if it isn't unique
+        bool optimum(QVector3D *v) const
+        {
+            double det = q[0]*(q[4]*q[7] - q[5]*q[5]) - q[1]*(q[1]*q[7] - q[5]*q[2]) + q[2]*(q[1]*q[5] - q[4]*q[2]);
+            if (std::abs(det) < 1e-10)
+                return false;
+
+            double bx = -q[3], by = -q[6], bz = -q[8];
+            double x = (bx*(q[4]*q[7] - q[5]*q[5]) - q[1]*(by*q[7] - q[5]*bz) + q[2]*(by*q[5] - q[4]*bz)) / det;
+            double y = (q[0]*(by*q[7] - bz*q[5]) - bx*(q[1]*q[7] - q[5]*q[2]) + q[2]*(q[1]*bz - by*q[2])) / det;
+            double z = (q[0]*(q[4]*bz - q[5]*by) - q[1]*(q[1]*bz - by*q[2]) + bx*(q[1]*q[5] - q[4]*q[2])) / det;
+            *v = QVector3D(x, y, z);
+            return true;
+        }
+    };
+
+    struct Candidate {
+        double cost;
+        double meanError; // cost per plane, compared against the tolerance
+        int a;
+        int b;
+        unsigned versionA;
+        unsigned versionB;
+        QVector3D position;
+
+        bool operator>(Candidate const &other) const
+        {
+            if (cost != other.cost)
+                return cost > other.cost;
+            if (a != other.a)
+                return a > other.a;
+            return b > other.b;
+        }
+    };
+
+    void push(int a, int b);
+    QVector<int> neighbors(int v) const;
+    bool canCollapse(int a, int b, QVector3D position) const;
+    int collapse(int a, int b, QVector3D position);
+    void compact();
+
+    TriangleMesh &mesh;
+    std::vector<Quadric> quadrics;
+    std::vector<std::vector<int>> vertexTriangles;
+    std::vector<unsigned> versions;
+    std::vector<quint8> removed;
+    std::vector<quint8> locked;
+    std::vector<quint8> triangleAlive;
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> heap;
+};
+
+Decimator::Decimator(TriangleMesh &mesh) : mesh(mesh)
+{
+    const int vertexCount = mesh.vertexList.size();
+    quadrics.resize(vertexCount);
+    vertexTriangles.resize(vertexCount);
+    versions.assign(vertexCount, 0);
+    removed.assign(vertexCount, 0);
+    locked.assign(vertexCount, 0);
+    triangleAlive.assign(mesh.triangles.size(), 1);
+
+    for (int t = 0; t < mesh.triangles.size(); ++t)
+    {
+        auto const &p = mesh.triangles[t].p;
+        QVector3D v0 = mesh.vertexList[p[0]];
+        QVector3D normal = QVector3D::normal(mesh.vertexList[p[1]] - v0, mesh.vertexList[p[2]] - v0);
+        Quadric plane = Quadric::plane(normal, -QVector3D::dotProduct(normal, v0));
+        for (int i = 0; i < 3; ++i)
+        {
+            quadrics[p[i]] += plane;
+            vertexTriangles[p[i]].push_back(t);
+        }
+    }
+
+    // Each edge as (low, high), an edge with only one triangle is on the boundary
+    std::vector<std::pair<int, int>> edges;
+    edges.reserve(mesh.triangles.size() * 3);
+    for (auto const &triangle: mesh.triangles)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            int a = triangle.p[i];
+            int b = triangle.p[(i + 1) % 3];
+            edges.push_back({std::min(a, b), std::max(a, b)});
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    for (size_t i = 0; i < edges.size();)
+    {
+        size_t next = i + 1;
+        while (next < edges.size() && edges[next] == edges[i])
+            next++;
+        if (next - i != 2)
+            locked[edges[i].first] = locked[edges[i].second] = 1;
+        i = next;
+    }
+
+    for (size_t i = 0; i < edges.size(); ++i)
+        if (i == 0 || edges[i] != edges[i - 1])
+            push(edges[i].first, edges[i].second);
+}
+
+void Decimator::push(int a, int b)
+{
+    if (locked[a] || locked[b])
+        return;
+
+    Quadric q = quadrics[a];
+    q += quadrics[b];
+
+    // Prefer the optimum unless it's far from the edge, where the quadric is nearly flat
+    QVector3D pa = mesh.vertexList[a];
+    QVector3D pb = mesh.vertexList[b];
+    QVector3D midpoint = (pa + pb) / 2;
+    QVector3D candidates[4] = {midpoint, pa, pb, midpoint};
+    QVector3D optimum;
+    int count = 3;
+    if (q.optimum(&optimum) && (optimum - midpoint).length() <= (pb - pa).length())
+        candidates[count++] = optimum;
+
+    Candidate best {std::numeric_limits<double>::infinity(), 0.0, a, b, versions[a], versions[b], midpoint};
+    for (int i = 0; i < count; ++i)
+    {
+        double cost = q.error(candidates[i]);
+        if (cost < best.cost)
+        {
+            best.cost = cost;
+            best.position = candidates[i];
+        }
+    }
+    best.meanError = q.planes > 0.0 ? best.cost / q.planes : 0.0;
+    heap.push(best);
+}
+
+QVector<int> Decimator::neighbors(int v) const
+{
+    QVector<int> result;
+    for (int t: vertexTriangles[v])
+    {
+        if (!triangleAlive[t])
+            continue;
+        for (int p: mesh.triangles[t].p)
+            if (p != v)
+                result.push_back(p);
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+bool Decimator::canCollapse(int a, int b, QVector3D position) const
+{
+    QVector<int> neighborsA = neighbors(a);
+    QVector<int> neighborsB = neighbors(b);
+
+    // Link condition: the only vertices next to both are the opposite corners of the edge's two triangles
+    QVector<int> common;
+    std::set_intersection(neighborsA.begin(), neighborsA.end(), neighborsB.begin(), neighborsB.end(), std::back_inserter(common));
+    QVector<int> opposite;
+    for (int t: vertexTriangles[a])
+    {
+        auto const &p = mesh.triangles[t].p;
+        if (triangleAlive[t] && (p[0] == b || p[1] == b || p[2] == b))
+            for (int v: p)
+                if (v != a && v != b)
+                    opposite.push_back(v);
+    }
+    std::sort(opposite.begin(), opposite.end());
+    if (opposite.size() != 2 || common != opposite)
+        return false;
+
+    // A tetrahedron is the smallest closed surface
+    if (neighborsA.size() + neighborsB.size() - common.size() - 2 <= 2)
+        return false;
+
+    // No remaining triangle may flip over
+    for (int v: {a, b})
+    {
+        for (int t: vertexTriangles[v])
+        {
+            auto const &p = mesh.triangles[t].p;
+            if (!triangleAlive[t] || ((p[0] == a || p[1] == a || p[2] == a) && (p[0] == b || p[1] == b || p[2] == b)))
+                continue;
+
+            QVector3D before[3];
+            QVector3D after[3];
+            for (int i = 0; i < 3; ++i)
+            {
+                before[i] = mesh.vertexList[p[i]];
+                after[i] = (p[i] == a || p[i] == b) ? position : before[i];
+            }
+            QVector3D normalBefore = QVector3D::crossProduct(before[1] - before[0], before[2] - before[0]);
+            QVector3D normalAfter = QVector3D::crossProduct(after[1] - after[0], after[2] - after[0]);
+            if (QVector3D::dotProduct(normalBefore, normalAfter) <= 0.0f)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// Merge b into a at position, returns the number of triangles removed
+int Decimator::collapse(int a, int b, QVector3D position)
+{
+    int removedTriangles = 0;
+    for (int t: vertexTriangles[b])
+    {
+        if (!triangleAlive[t])
+            continue;
+
+        auto &p = mesh.triangles[t].p;
+        if (p[0] == a || p[1] == a || p[2] == a)
+        {
+            triangleAlive[t] = 0;
+            removedTriangles++;
+            continue;
+        }
+
+        for (auto &v: p)
+            if (v == b)
+                v = a;
+        vertexTriangles[a].push_back(t);
+    }
+
+    auto &trianglesA = vertexTriangles[a];
+    trianglesA.erase(std::remove_if(trianglesA.begin(), trianglesA.end(), [this](int t) { return !triangleAlive[t]; }),
+                     trianglesA.end());
+    vertexTriangles[b] = {};
+
+    mesh.vertexList[a] = position;
+    if (!mesh.normalList.isEmpty())
+        mesh.normalList[a] = mesh.normalList[a].normalized() + mesh.normalList[b].normalized();
+    quadrics[a] += quadrics[b];
+    removed[b] = 1;
+    versions[a]++;
+
+    return removedTriangles;
+}
+
+void Decimator::run(int targetTriangles, float maxError, std::atomic<bool> const *cancel)
+{
+    int liveTriangles = mesh.triangles.size();
+    const double maxCost = double(maxError) * maxError;
+    int iterations = 0;
+
+    while (!heap.empty())
+    {
+        if (targetTriangles > 0 && liveTriangles <= targetTriangles)
+            break;
+        if (cancel && (++iterations & 0xfff) == 0 && *cancel)
+            return;
+
+        Candidate candidate = heap.top();
+        heap.pop();
+        if (removed[candidate.a] || removed[candidate.b] ||
+            versions[candidate.a] != candidate.versionA || versions[candidate.b] != candidate.versionB)
+            continue;
+
+        // The heap is ordered by the summed error, but the tolerance applies to the mean so it
+        // doesn't depend on how many triangles have been merged into the vertices. Collapses
+        // over it are skipped rather than ending the search.
+        if (maxError > 0.0f && candidate.meanError > maxCost)
+            continue;
+
+        if (!canCollapse(candidate.a, candidate.b, candidate.position))
+            continue;
+
+        liveTriangles -= collapse(candidate.a, candidate.b, candidate.position);
+        for (int n: neighbors(candidate.a))
+            push(candidate.a, n);
+    }
+
+    compact();
+}
+
+void Decimator::compact()
+{
+    QVector<int> remap(mesh.vertexList.size(), -1);
+    QVector<QVector3D> vertexList;
+    QVector<QVector3D> normalList;
+    for (int v = 0; v < mesh.vertexList.size(); ++v)
+    {
+        if (removed[v])
+            continue;
+        remap[v] = vertexList.size();
+        vertexList.push_back(mesh.vertexList[v]);
+        if (!mesh.normalList.isEmpty())
+            normalList.push_back(mesh.normalList[v]);
+    }
+
+    QVector<Triangle> triangles;
+    for (int t = 0; t < mesh.triangles.size(); ++t)
+    {
+        if (!triangleAlive[t])
+            continue;
+        Triangle triangle;
+        for (int i = 0; i < 3; ++i)
+            triangle.p[i] = remap[mesh.triangles[t].p[i]];
+        triangles.push_back(triangle);
+    }
+
+    mesh.vertexList = vertexList;
+    mesh.normalList = normalList;
+    mesh.triangles = triangles;
+}
+
+// Each lobe's indices are offset by the number of vertices in the lobes before it
+template <typename Index>
+void packIndices(std::vector<TriangleMesh> const &lobes, Index *out)
+{
+    int offset = 0;
+    for (auto const &lobe: lobes)
+    {
+        for (auto const &triangle: lobe.triangles)
+        {
+            out[0] = Index(triangle.p[0] + offset);
+            out[1] = Index(triangle.p[1] + offset);
+            out[2] = Index(triangle.p[2] + offset);
+            out += 3;
+        }
+        offset += lobe.vertexList.size();
+    }
+}
+
+const char meshMagic[4] = {'C', 'V', 'S', 'M'};
+const quint32 meshVersion = 1;
+const int meshHeaderSize = 4 + 4 + 4 + 3 * 4;
+
+} // namespace
+
+IsosurfaceOptions IsosurfaceOptions::fromSettings()
+{
+    IsosurfaceOptions result;
+    if (QSettings().value("IsosurfaceEngine").toString() == "MarchingCubes")
+        result.engine = Engine::MarchingCubes;
+    if (QSettings().value("IsosurfaceNormals").toString() == "Gradient")
+        result.normals = Normals::Gradient;
+    result.targetTriangles = QSettings().value("IsosurfaceTriangleBudget", 0).toInt();
+    result.maxError = QSettings().value("IsosurfaceMaxError", 0.0f).toFloat();
+    return result;
+}
+
+QString IsosurfaceOptions::modeKey() const
+{
+    QString key = engine == Engine::MarchingCubes ? "MarchingCubes" : "FlyingEdges";
+    if (normals == Normals::Gradient)
+        key += "/GradientNormals";
+    if (targetTriangles > 0 || maxError > 0.0f)
+        key += QStringLiteral("/Decimate:%1:%2").arg(targetTriangles).arg(maxError);
+    if (!clipPlane.isNull())
+        key += QStringLiteral("/Clip:%1:%2:%3:%4").arg(clipPlane.x()).arg(clipPlane.y()).arg(clipPlane.z()).arg(clipPlane.w());
+    return key;
+}
+
+IsosurfaceMesh IsosurfaceMesh::build(const VolumeData &volume, float threshold, IsosurfaceOptions const &options)
+{
+    // The negative lobe is the surface of the negated volume at the same threshold
+    QVector<float> signs = {1.0f};
+    if (options.dual && threshold > 0.0f)
+        signs.push_back(-1.0f);
+
+    std::vector<TriangleMesh> lobes(signs.size());
+    if (options.engine == IsosurfaceOptions::Engine::FlyingEdges)
+    {
+        FlyingEdges fe(options.normals == IsosurfaceOptions::Normals::Gradient);
+        for (int i = 0; i < signs.size(); ++i)
+            fe.addSurface(signs[i], &lobes[i]);
+        Progress progress(options, fe.stepCount(volume));
+        fe.build(volume, threshold, options.threadCount, progress);
+    }
+    else
+    {
+        Progress progress(options, signs.size() * marchingCubesSlabCount(volume));
+        for (int i = 0; i < signs.size() && !progress.cancelled(); ++i)
+            buildMarchingCubes(volume, signs[i], threshold, options, progress, lobes[i]);
+    }
+
+    // The triangle budget is shared between the lobes by their size
+    if (options.targetTriangles > 0 || options.maxError > 0.0f)
+    {
+        int total = 0;
+        for (auto const &lobe: lobes)
+            total += lobe.triangles.size();
+        for (auto &lobe: lobes)
+        {
+            int target = options.targetTriangles > 0 ? std::max(int(qint64(options.targetTriangles) * lobe.triangles.size() / std::max(total, 1)), 1) : 0;
+            Decimator(lobe).run(target, options.maxError, options.cancel.get());
+        }
+    }
+
+    if (options.cancel && *options.cancel)
+        return IsosurfaceMesh();
+
+    int vertexCount = 0;
+    int triangleCount = 0;
+    for (auto &lobe: lobes)
+    {
+        lobe.finish(volume.transform);
+        if (!options.clipPlane.isNull())
+            lobe.clip(options.clipPlane);
+        vertexCount += lobe.vertexList.size();
+        triangleCount += lobe.triangles.size();
+    }
+
+//    qDebug() << "IsosurfaceMesh:" << vertexCount << "vertices," << triangleCount << "triangles";
+
+    // Pack straight into the buffers that are uploaded, in native byte order
+    QByteArray vertexData(vertexCount * vertexStride, Qt::Uninitialized);
+    float *vertexOut = reinterpret_cast<float *>(vertexData.data());
+    for (auto const &lobe: lobes)
+    {
+        for (int i = 0; i < lobe.vertexList.size(); ++i)
+        {
+            QVector3D const &vertex = lobe.vertexList[i];
+            QVector3D const &normal = lobe.normalList[i];
+            vertexOut[0] = vertex.x();
+            vertexOut[1] = vertex.y();
+            vertexOut[2] = vertex.z();
+            vertexOut[3] = normal.x();
+            vertexOut[4] = normal.y();
+            vertexOut[5] = normal.z();
+            vertexOut += 6;
+        }
+    }
+
+    const bool shortIndices = vertexCount <= 0x10000;
+    QByteArray indexData(triangleCount * 3 * int(shortIndices ? sizeof(quint16) : sizeof(quint32)), Qt::Uninitialized);
+    if (shortIndices)
+        packIndices(lobes, reinterpret_cast<quint16 *>(indexData.data()));
+    else
+        packIndices(lobes, reinterpret_cast<quint32 *>(indexData.data()));
+
+    IsosurfaceMesh result;
+    result.vertexData = vertexData;
+    result.indexData = indexData;
+    result.shortIndices = shortIndices;
+    result.vertexCount = vertexCount;
+    result.indexCount = triangleCount*3;
+    if (lobes.size() > 1)
+        result.negativeIndexCount = lobes[1].triangles.size()*3;
+
+    return result;
+}
+
+void IsosurfaceMesh::mapProperty(const VolumeData &volume, int threadCount)
+{
+    // Gather the positions out of the interleaved vertices so they can be sampled in batches
+    const float *vertices = reinterpret_cast<const float *>(vertexData.constData());
+    QVector<QVector3D> positions(vertexCount);
+    for (int i = 0; i < vertexCount; ++i)
+        positions[i] = QVector3D(vertices[i * 6], vertices[i * 6 + 1], vertices[i * 6 + 2]);
+
+    propertyData = QByteArray(vertexCount * int(sizeof(float)), Qt::Uninitialized);
+    float *values = reinterpret_cast<float *>(propertyData.data());
+
+    const int chunkSize = 16384;
+    const int chunks = (vertexCount + chunkSize - 1) / chunkSize;
+    IsosurfaceOptions options;
+    Progress progress(options, chunks);
+    parallelFor(chunks, threadCount, progress, [&](int chunk) {
+        int begin = chunk * chunkSize;
+        volume.sample(positions.constData() + begin, std::min(chunkSize, vertexCount - begin), values + begin);
+    });
+
+    propertyMin = vertexCount ? *std::min_element(values, values + vertexCount) : 0.0f;
+    propertyMax = vertexCount ? *std::max_element(values, values + vertexCount) : 0.0f;
+}
+
+IsosurfaceMesh::IsosurfaceMesh(const QByteArray &serialized)
+{
+    if (serialized.size() < meshHeaderSize || !serialized.startsWith(QByteArray(meshMagic, 4)))
+        throw QString("Invalid surface mesh data");
+
+    QDataStream stream(serialized);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.skipRawData(4);
+
+    quint32 version;
+    quint32 flags;
+    qint32 vertices, indices, negativeIndices;
+    stream >> version >> flags >> vertices >> indices >> negativeIndices;
+
+    if (version != meshVersion)
+        throw QString("Unknown surface mesh version: %1").arg(version);
+    if (vertices < 0 || indices < 0 || indices % 3 || negativeIndices < 0 || negativeIndices > indices)
+        throw QString("Invalid surface mesh size");
+
+    shortIndices = flags & 1;
+    vertexCount = vertices;
+    indexCount = indices;
+    negativeIndexCount = negativeIndices;
+
+    qint64 vertexBytes = qint64(vertexCount) * vertexStride;
+    qint64 indexBytes = qint64(indexCount) * indexSize();
+    if (serialized.size() - meshHeaderSize != vertexBytes + indexBytes)
+        throw QString("Surface mesh size doesn't match its counts");
+
+    const char *payload = serialized.constData() + meshHeaderSize;
+    vertexData = QByteArray(int(vertexBytes), Qt::Uninitialized);
+    qFromLittleEndian<quint32>(payload, vertexBytes / sizeof(quint32), vertexData.data());
+    indexData = QByteArray(int(indexBytes), Qt::Uninitialized);
+    if (shortIndices)
+        qFromLittleEndian<quint16>(payload + vertexBytes, indexCount, indexData.data());
+    else
+        qFromLittleEndian<quint32>(payload + vertexBytes, indexCount, indexData.data());
+
+    // An index past the end of the vertices would read outside the GPU buffer
+    for (int i = 0; i < indexCount; ++i)
+    {
+        quint32 index = shortIndices ? reinterpret_cast<const quint16 *>(indexData.constData())[i]
+                                     : reinterpret_cast<const quint32 *>(indexData.constData())[i];
+        if (index >= quint32(vertexCount))
+            throw QString("Invalid surface mesh index");
+    }
+}
+
+QByteArray IsosurfaceMesh::serialize() const
+{
+    QByteArray result;
+    result.reserve(meshHeaderSize + vertexData.size() + indexData.size());
+
+    QDataStream stream(&result, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.writeRawData(meshMagic, 4);
+    stream << meshVersion << quint32(shortIndices ? 1 : 0)
+           << qint32(vertexCount) << qint32(indexCount) << qint32(negativeIndexCount);
+
+    result.resize(meshHeaderSize + vertexData.size() + indexData.size());
+    char *payload = result.data() + meshHeaderSize;
+    qToLittleEndian<quint32>(vertexData.constData(), vertexData.size() / sizeof(quint32), payload);
+    if (shortIndices)
+        qToLittleEndian<quint16>(indexData.constData(), indexCount, payload + vertexData.size());
+    else
+        qToLittleEndian<quint32>(indexData.constData(), indexCount, payload + vertexData.size());
+
+    return result;
+}
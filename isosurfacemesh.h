@@ -0,0 +1,90 @@
+#ifndef ISOSURFACEMESH_H
+#define ISOSURFACEMESH_H
+
+#include "volumedata.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QVector4D>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+struct IsosurfaceOptions
+{
+    enum class Engine {
+        MarchingCubes, // The reference implementation
+        FlyingEdges
+    };
+
+    enum class Normals {
+        Faces,    // Averaged from the faces around each vertex once the mesh is complete
+        Gradient  // Interpolated from the volume's gradient as each vertex is created
+    };
+
+    Engine engine = Engine::FlyingEdges;
+    Normals normals = Normals::Faces;
+    int threadCount = 0; // 0 for one thread per core
+    // Also extract the surface at -threshold, for the negative lobe of signed volumes
+    bool dual = false;
+    // Simplify the mesh until it has at most targetTriangles, without moving any merged vertex
+    // further than maxError grid cells (root mean square) from the original triangles around
+    // it. 0 disables either limit.
+    int targetTriangles = 0;
+    float maxError = 0.0f;
+    // World space plane (a, b, c, d), only triangles entirely on the side where
+    // ax + by + cz + d >= 0 are kept. All zero disables clipping.
+    QVector4D clipPlane;
+
+    // Called from the building threads with the percent of the work done so far, calls
+    // from different threads may arrive out of order
+    std::function<void(int)> progress;
+    // Checked after each slice of the volume, once set the build stops and returns an empty mesh
+    std::shared_ptr<std::atomic<bool>> cancel;
+
+    // The options chosen in the application settings
+    static IsosurfaceOptions fromSettings();
+    // Identifies the options that change the mesh built from a given volume and threshold
+    QString modeKey() const;
+};
+
+// A triangle mesh packed in the layout the 3D view uploads to its buffers
+struct IsosurfaceMesh
+{
+    static const int vertexStride = 6 * sizeof(float); /* 3 float vertex + 3 float normal */
+
+    IsosurfaceMesh() = default;
+    // Load a mesh written by serialize(), throws a QString if the data is invalid
+    explicit IsosurfaceMesh(QByteArray const &serialized);
+
+    QByteArray vertexData;
+    QByteArray indexData; // Three indices per triangle, uint16 if shortIndices otherwise uint32
+    bool shortIndices = false;
+    int vertexCount = 0;
+    int indexCount = 0;
+    // In dual mode the last negativeIndexCount indices are the negative lobe
+    int negativeIndexCount = 0;
+    // One float per vertex sampled from another volume by mapProperty(), empty if unmapped.
+    // Not part of serialize(), a saved mesh is mapped again when it's loaded.
+    QByteArray propertyData;
+    float propertyMin = 0.0f;
+    float propertyMax = 0.0f;
+
+    int indexSize() const
+    {
+        return shortIndices ? sizeof(quint16) : sizeof(quint32);
+    }
+
+    // Extract the surface where the volume crosses threshold, doesn't touch any
+    // shared state so it may be called from a worker thread. The result doesn't
+    // depend on the number of threads used.
+    static IsosurfaceMesh build(VolumeData const &volume, float threshold, IsosurfaceOptions const &options = IsosurfaceOptions());
+
+    // Sample volume at each vertex into propertyData, e.g. to color a density surface by the
+    // electrostatic potential. Uses up to threadCount threads, 0 for one per core.
+    void mapProperty(VolumeData const &volume, int threadCount = 0);
+
+    QByteArray serialize() const;
+};
+
+#endif // ISOSURFACEMESH_H
@@ -1,4 +1,5 @@
 #include "linebuffer.h"
+#include "parsehelpers.h"
 #include <QDebug>
 
 LineBuffer::LineBuffer()
@@ -24,6 +25,18 @@ int LineBuffer::append(QByteArray data)
     return linesAdded;
 }
 
+void LineBuffer::setRawData(QByteArray const &data)
+{
+    lines.clear();
+    LineScanner scanner(data);
+    while (!scanner.atEnd())
+        lines.append(scanner.next());
+
+    // Match append(), which ends with an empty line after a trailing line ending
+    if (data.isEmpty() || data.endsWith('\n') || data.endsWith('\r'))
+        lines.append(QByteArray());
+}
+
 QByteArray LineBuffer::joined() const
 {
     return joinRange(0, lines.size());
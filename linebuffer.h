@@ -10,6 +10,10 @@ public:
     LineBuffer();
 
     int append(QByteArray data);
+    // Replace the lines with slices of data instead of copies, data must outlive their use.
+    // Unlike append() this also accepts "\r\n" and "\r" line endings, and the lines aren't
+    // NUL terminated.
+    void setRawData(QByteArray const &data);
     QByteArray joined() const;
     QByteArray joinLast(int count) const;
     QByteArray joinRange(int start, int count) const;
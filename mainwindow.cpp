@@ -17,6 +17,7 @@
 #include "cvprojfile.h"
 #include "calculation_util.h"
 #include "optimizererrordialog.h"
+#include "isosurfacecache.h"
 
 #include <QSettings>
 #include <QCloseEvent>
@@ -28,11 +29,13 @@
 #include <QTemporaryFile>
 #include <QMessageBox>
 #include <QProgressDialog>
+#include <QProgressBar>
 #include <QMimeData>
 #include <QWindow>
 #include <QSaveFile>
 #include <QDesktopServices>
 #include <QActionGroup>
+#include <QMutex>
 
 struct MolDocState {
     MolDocument document;
@@ -41,6 +44,16 @@ struct MolDocState {
 
     QString activeSurface;
     float activeSurfaceThreshold = 0.01;
+    // When nonzero the threshold is chosen to enclose this fraction of the surface's density
+    float activeSurfaceEnclosedFraction = 0.0f;
+    // The volume sampled at the surface's vertices to color it, e.g. the electrostatic potential
+    QString activeSurfaceProperty;
+    // When set the surface is only extracted inside the world space box from regionMin to
+    // regionMax, and only the part in front of the clip plane is kept (all zero for none)
+    bool activeSurfaceHasRegion = false;
+    QVector3D activeSurfaceRegionMin;
+    QVector3D activeSurfaceRegionMax;
+    QVector4D activeSurfaceClipPlane;
 
     QString undoDescription;
 };
@@ -56,6 +69,19 @@ struct TabState {
 
     int activeAnimation = -1;
 
+    // Shared with surface jobs that may finish after the tab is closed
+    std::shared_ptr<IsosurfaceCache> surfaceCache = std::make_shared<IsosurfaceCache>();
+    // The active surface's volume cropped to its region, so changing the isovalue doesn't crop it again.
+    // It's cropped by the surface jobs, which may still be running after the tab is closed.
+    struct RegionVolume {
+        QMutex lock;
+        quint64 volumeId = 0;
+        QVector3D min;
+        QVector3D max;
+        VolumeData volume;
+    };
+    std::shared_ptr<RegionVolume> regionVolume = std::make_shared<RegionVolume>();
+
     QString filePath;
     bool modified = false;
 };
@@ -73,6 +99,7 @@ public:
     QActionGroup *drawStyleActionGroup = nullptr;
 
     QLabel *statusBarRight = nullptr;
+    QProgressBar *surfaceProgress = nullptr;
 
     PropertiesWindow *propertiesWindow = nullptr;
 
@@ -94,6 +121,12 @@ public:
     void replaceToolWidget(QWidget *w);
     void updatePropertiesWindow(bool ifHidden = false);
     void showCurrentMolecule();
+    void showActiveSurface();
+    // The options and cache key the active surface is built with, shared so saved meshes match shown ones
+    IsosurfaceOptions activeSurfaceOptions(TabState *ts);
+    IsosurfaceCache::Key activeSurfaceKey(TabState *ts, float threshold);
+    // The tab's document along with its active surface and that surface's mesh if it's been built
+    MolDocument documentWithActiveSurface(TabState *ts);
     void moleculeChanged();
     void runCalculation(std::shared_ptr<Optimizer> optimizer , QString title, bool saveOptimizer, bool generateUndoStep);
 
@@ -137,10 +170,140 @@ void MainWindowPrivate::showCurrentMolecule()
 //    qDebug() << "Show surface:" << current.activeSurface;
 
     if (!ts->current.activeSurface.isEmpty() && ts->current.document.volumes.contains(ts->current.activeSurface))
-        mol3dView->showVolumeData(ts->current.document.volumes.value(ts->current.activeSurface), ts->current.activeSurfaceThreshold);
+        showActiveSurface();
     inShowMolecule = false;
 }
 
+void MainWindowPrivate::showActiveSurface()
+{
+    auto ts = activeTabState();
+    VolumeHandle handle = ts->current.document.volumes.value(ts->current.activeSurface);
+    VolumeHandle propertyHandle = ts->current.document.volumes.value(ts->current.activeSurfaceProperty);
+    const float enclosedFraction = ts->current.activeSurfaceEnclosedFraction;
+    const bool enclosed = enclosedFraction > 0.0f;
+
+    // The threshold enclosing a fraction of the density needs the volume's statistics, once it's
+    // been found the cached mesh can be shown without loading the volume
+    float threshold = ts->current.activeSurfaceThreshold;
+    const bool knownThreshold = !enclosed || ts->surfaceCache->findThreshold(handle.id(), enclosedFraction, &threshold);
+
+    IsosurfaceCache::Key key = activeSurfaceKey(ts, threshold);
+    IsosurfaceMesh mesh;
+    if (knownThreshold && ts->surfaceCache->find(key, &mesh))
+    {
+        mol3dView->showSurfaceMesh(mesh);
+        return;
+    }
+
+    // Loading the volumes, picking the threshold and cropping the region all happen on the
+    // surface thread along with the build
+    const bool hasRegion = ts->current.activeSurfaceHasRegion;
+    const QVector3D regionMin = ts->current.activeSurfaceRegionMin;
+    const QVector3D regionMax = ts->current.activeSurfaceRegionMax;
+    auto region = ts->regionVolume;
+    auto prepare = [handle, propertyHandle, threshold, enclosedFraction, hasRegion, regionMin, regionMax, region]() {
+        Mol3dView::SurfaceSource source;
+        source.threshold = threshold;
+        try {
+            source.volume = handle.data();
+        } catch (QString err) {
+            qWarning() << "Failed to load surface:" << err;
+            return source;
+        }
+
+        if (enclosedFraction > 0.0f)
+            source.threshold = source.volume.statistics().thresholdForEnclosedFraction(enclosedFraction);
+
+        // Only the region is copied out of the volume, so building it costs in proportion to the region
+        if (hasRegion)
+        {
+            QMutexLocker locker(&region->lock);
+            if (region->volumeId != handle.id() || region->min != regionMin || region->max != regionMax)
+            {
+                region->volume = source.volume.cropped(regionMin, regionMax);
+                region->volumeId = handle.id();
+                region->min = regionMin;
+                region->max = regionMax;
+            }
+            source.volume = region->volume;
+        }
+
+        try {
+            source.property = propertyHandle.data();
+        } catch (QString err) {
+            qWarning() << "Failed to load surface property:" << err;
+        }
+        return source;
+    };
+
+    auto cache = ts->surfaceCache;
+    const quint64 volumeId = handle.id();
+    mol3dView->showVolumeData(prepare, [cache, key, volumeId, enclosedFraction](IsosurfaceMesh const &mesh, float threshold) {
+        IsosurfaceCache::Key meshKey = key;
+        meshKey.threshold = threshold;
+        // A property that failed to load isn't on the mesh
+        if (mesh.propertyData.isEmpty())
+            meshKey.propertyId = 0;
+        if (enclosedFraction > 0.0f)
+            cache->insertThreshold(volumeId, enclosedFraction, threshold);
+        cache->insert(meshKey, mesh);
+    }, activeSurfaceOptions(ts));
+}
+
+IsosurfaceOptions MainWindowPrivate::activeSurfaceOptions(TabState *ts)
+{
+    IsosurfaceOptions options = IsosurfaceOptions::fromSettings();
+    options.clipPlane = ts->current.activeSurfaceClipPlane;
+    return options;
+}
+
+IsosurfaceCache::Key MainWindowPrivate::activeSurfaceKey(TabState *ts, float threshold)
+{
+    MolDocState const &state = ts->current;
+    QString mode = activeSurfaceOptions(ts).modeKey();
+    if (state.activeSurfaceHasRegion)
+    {
+        QVector3D const &min = state.activeSurfaceRegionMin;
+        QVector3D const &max = state.activeSurfaceRegionMax;
+        mode += QStringLiteral("/Region:%1:%2:%3:%4:%5:%6").arg(min.x()).arg(min.y()).arg(min.z())
+                                                            .arg(max.x()).arg(max.y()).arg(max.z());
+    }
+
+    return {state.document.volumes.value(state.activeSurface).id(), threshold, mode,
+            state.document.volumes.value(state.activeSurfaceProperty).id()};
+}
+
+MolDocument MainWindowPrivate::documentWithActiveSurface(TabState *ts)
+{
+    MolDocument document = ts->current.document;
+    if (ts->current.activeSurface.isEmpty() || !document.volumes.contains(ts->current.activeSurface))
+        return document;
+
+    document.activeSurface = ts->current.activeSurface;
+    document.activeSurfaceThreshold = ts->current.activeSurfaceThreshold;
+    document.activeSurfaceEnclosedFraction = ts->current.activeSurfaceEnclosedFraction;
+    if (document.volumes.contains(ts->current.activeSurfaceProperty))
+        document.activeSurfaceProperty = ts->current.activeSurfaceProperty;
+    document.activeSurfaceHasRegion = ts->current.activeSurfaceHasRegion;
+    document.activeSurfaceRegionMin = ts->current.activeSurfaceRegionMin;
+    document.activeSurfaceRegionMax = ts->current.activeSurfaceRegionMax;
+    document.activeSurfaceClipPlane = ts->current.activeSurfaceClipPlane;
+
+    // An enclosed fraction's threshold is known once its mesh has been built
+    VolumeHandle handle = document.volumes.value(ts->current.activeSurface);
+    float threshold = ts->current.activeSurfaceThreshold;
+    const float enclosedFraction = ts->current.activeSurfaceEnclosedFraction;
+    if (enclosedFraction > 0.0f && !ts->surfaceCache->findThreshold(handle.id(), enclosedFraction, &threshold))
+        return document;
+
+    IsosurfaceCache::Key key = activeSurfaceKey(ts, threshold);
+    IsosurfaceMesh mesh;
+    if (ts->surfaceCache->find(key, &mesh))
+        document.surfaceMeshes.push_back({document.activeSurface, threshold, key.mode, document.activeSurfaceProperty, mesh});
+
+    return document;
+}
+
 void MainWindowPrivate::moleculeChanged()
 {
     Q_Q(MainWindow);
@@ -152,6 +315,9 @@ void MainWindowPrivate::moleculeChanged()
         ts->current.calculation.reset();
         ts->current.document = MolDocument(mol3dView->getMolStruct());
         ts->current.activeSurface = QString();
+        ts->current.activeSurfaceProperty = QString();
+        ts->current.activeSurfaceHasRegion = false;
+        ts->current.activeSurfaceClipPlane = QVector4D();
         ts->modified = true;
     }
 
@@ -491,6 +657,11 @@ MainWindow::MainWindow(QWidget *parent)
     // Set up status bar
     d->statusBarRight = new QLabel("");
     ui->statusbar->addPermanentWidget(d->statusBarRight);
+    d->surfaceProgress = new QProgressBar();
+    d->surfaceProgress->setMaximumWidth(150);
+    d->surfaceProgress->setFormat(tr("Surface %p%"));
+    d->surfaceProgress->hide();
+    ui->statusbar->addPermanentWidget(d->surfaceProgress);
 
     // Draw style group
     d->drawStyleActionGroup = new QActionGroup(this);
@@ -506,6 +677,12 @@ MainWindow::MainWindow(QWidget *parent)
                 ui->statusbar->showMessage(info);
             });
 
+    connect(ui->mol3dview, &Mol3dView::surfaceProgress, this,
+            [d](int percent) {
+                d->surfaceProgress->setValue(percent);
+                d->surfaceProgress->setVisible(percent < 100);
+            });
+
     connect(ui->mol3dview, &Mol3dView::moleculeChanged, this,
             [d]() {
                 d->moleculeChanged();
@@ -569,6 +746,8 @@ void MainWindow::connectActions()
     connect(ui->actionStyle_Ball_and_Stick, &QAction::triggered, this, &MainWindow::actionStyleBallandStick);
     connect(ui->actionStyle_Stick, &QAction::triggered, this, &MainWindow::actionStyleStick);
     connect(ui->actionShow_Info, &QAction::triggered, this, &MainWindow::actionShowInfo);
+    connect(ui->actionSurfaceRegion, &QAction::triggered, this, &MainWindow::actionSurfaceRegion);
+    connect(ui->actionSurfaceClip, &QAction::triggered, this, &MainWindow::actionSurfaceClip);
 
     // Calculate
     connect(ui->actionConfigure_NWChem, &QAction::triggered, this, &MainWindow::actionConfigureNWChem);
@@ -612,17 +791,20 @@ bool MainWindow::doSave(QString filename, bool saveAs)
     QSaveFile file(filename);
 
     auto ts = d->activeTabState();
+    const bool isProject = filename.endsWith(".cvproj");
+    MolDocument document;
 
     try
     {
         if(!file.open(QIODevice::WriteOnly))
             throw file.errorString();
-        if (filename.endsWith(".cvproj"))
+        if (isProject)
         {
+            document = d->documentWithActiveSurface(ts);
             if (OptimizerNWChem *nwchemOpt = qobject_cast<OptimizerNWChem *>(ts->current.calculation.get()))
-                CVProjFile::write(&file, ts->current.document, *nwchemOpt);
+                CVProjFile::write(&file, document, *nwchemOpt);
             else
-                CVProjFile::write(&file, ts->current.document);
+                CVProjFile::write(&file, document);
         }
         else
         {
@@ -660,6 +842,11 @@ bool MainWindow::doSave(QString filename, bool saveAs)
         return false;
     }
 
+    // The document shares its volume handles with the tab, after Save As they must stop
+    // reading from the old file
+    if (isProject)
+        CVProjFile::attachVolumes(filename, document);
+
     ts->modified = false;
     ts->filePath = filename;
     d->activateTab(d->activeTab);
@@ -796,6 +983,60 @@ void MainWindow::actionShowInfo()
     d->propertiesWindow->raise();
 }
 
+void MainWindow::actionSurfaceRegion(bool checked)
+{
+    Q_D(MainWindow);
+    auto ts = d->activeTabState();
+    ts->current.activeSurfaceHasRegion = false;
+
+    // The box around the selected atoms, grown by the margin so the density around them is included
+    auto selection = d->mol3dView->getSelection();
+    auto const &atoms = ts->current.document.molecule.atoms;
+    if (checked && !selection.atoms.isEmpty())
+    {
+        const float margin = QSettings().value("IsosurfaceRegionMargin", 4.0f).toFloat();
+        QVector3D low = atoms.at(selection.atoms.first()).posToVector();
+        QVector3D high = low;
+        for (int index: selection.atoms)
+        {
+            QVector3D p = atoms.at(index).posToVector();
+            low = QVector3D(std::min(low.x(), p.x()), std::min(low.y(), p.y()), std::min(low.z(), p.z()));
+            high = QVector3D(std::max(high.x(), p.x()), std::max(high.y(), p.y()), std::max(high.z(), p.z()));
+        }
+        ts->current.activeSurfaceHasRegion = true;
+        ts->current.activeSurfaceRegionMin = low - QVector3D(margin, margin, margin);
+        ts->current.activeSurfaceRegionMax = high + QVector3D(margin, margin, margin);
+    }
+
+    syncMenuStates();
+    if (!ts->current.activeSurface.isEmpty() && ts->current.document.volumes.contains(ts->current.activeSurface))
+        d->showActiveSurface();
+}
+
+void MainWindow::actionSurfaceClip(bool checked)
+{
+    Q_D(MainWindow);
+    auto ts = d->activeTabState();
+    ts->current.activeSurfaceClipPlane = QVector4D();
+
+    // The plane through the first three selected atoms, e.g. the plane of a ring
+    auto selection = d->mol3dView->getSelection();
+    auto const &atoms = ts->current.document.molecule.atoms;
+    if (checked && selection.atoms.size() >= 3)
+    {
+        QVector3D a = atoms.at(selection.atoms[0]).posToVector();
+        QVector3D b = atoms.at(selection.atoms[1]).posToVector();
+        QVector3D c = atoms.at(selection.atoms[2]).posToVector();
+        QVector3D normal = QVector3D::normal(b - a, c - a);
+        if (!normal.isNull())
+            ts->current.activeSurfaceClipPlane = QVector4D(normal, -QVector3D::dotProduct(normal, a));
+    }
+
+    syncMenuStates();
+    if (!ts->current.activeSurface.isEmpty() && ts->current.document.volumes.contains(ts->current.activeSurface))
+        d->showActiveSurface();
+}
+
 void MainWindow::actionConfigureNWChem()
 {
     Q_D(MainWindow);
@@ -898,7 +1139,7 @@ void MainWindow::cleanUpButtonClicked()
     d->runCalculation(std::move(optimizer), "OpenBabel Force Field Optmization", false, true);
 }
 
-void MainWindow::generateNWChemSurface(QString name, float threshold)
+void MainWindow::generateNWChemSurface(QString name, float threshold, float enclosedFraction)
 {
     Q_D(MainWindow);
 
@@ -906,11 +1147,12 @@ void MainWindow::generateNWChemSurface(QString name, float threshold)
 
     ts->current.activeSurface = name;
     ts->current.activeSurfaceThreshold = threshold;
+    ts->current.activeSurfaceEnclosedFraction = enclosedFraction;
 
     if (ts->current.document.volumes.contains(name))
     {
         animateFrequency(-1);
-        d->mol3dView->showVolumeData(ts->current.document.volumes.value(ts->current.activeSurface), ts->current.activeSurfaceThreshold);
+        d->showActiveSurface();
     }
     else if (OptimizerNWChem *savedOpt = qobject_cast<OptimizerNWChem *>(ts->current.calculation.get()))
     {
@@ -919,6 +1161,32 @@ void MainWindow::generateNWChemSurface(QString name, float threshold)
     }
 }
 
+void MainWindow::setSurfaceIsovalue(float threshold, float enclosedFraction)
+{
+    Q_D(MainWindow);
+
+    auto ts = d->activeTabState();
+
+    ts->current.activeSurfaceThreshold = threshold;
+    ts->current.activeSurfaceEnclosedFraction = enclosedFraction;
+
+    if (!ts->current.activeSurface.isEmpty() && ts->current.document.volumes.contains(ts->current.activeSurface))
+        d->showActiveSurface();
+}
+
+void MainWindow::setSurfaceProperty(QString name)
+{
+    Q_D(MainWindow);
+
+    auto ts = d->activeTabState();
+    if (!name.isEmpty() && !ts->current.document.volumes.contains(name))
+        return;
+    ts->current.activeSurfaceProperty = name;
+
+    if (!ts->current.activeSurface.isEmpty() && ts->current.document.volumes.contains(ts->current.activeSurface))
+        d->showActiveSurface();
+}
+
 void MainWindow::animateFrequency(int index)
 {
     Q_D(MainWindow);
@@ -1080,6 +1348,9 @@ void MainWindow::syncMenuStates()
 
     ui->actionUndo->setEnabled(!ts->undoStack.isEmpty());
     ui->actionRedo->setEnabled(!ts->redoStack.isEmpty());
+
+    ui->actionSurfaceRegion->setChecked(ts->current.activeSurfaceHasRegion);
+    ui->actionSurfaceClip->setChecked(!ts->current.activeSurfaceClipPlane.isNull());
 }
 
 void MainWindow::openFile(QString filename) {
@@ -1096,6 +1367,7 @@ void MainWindow::openFile(QString filename) {
         if (filename.endsWith(".cvproj"))
         {
             document = CVProjFile::fromPath(filename);
+            activeSurface = document.activeSurface;
             try {
                 loadedOpt = OptimizerNWChem::fromProjFile(filename, "molecule_nwchem", document.molecule);
             } catch (QString err) {
@@ -1111,7 +1383,7 @@ void MainWindow::openFile(QString filename) {
         else if (filename.endsWith(".cube"))
         {
             document = CubeFile::fromCube(filename);
-            if (!document.volumes.isEmpty() && document.volumes.first().size())
+            if (!document.volumes.isEmpty() && document.volumes.first().data().size())
                 activeSurface = document.volumes.firstKey();
         }
         else if (filename.endsWith(".xyz"))
@@ -1140,7 +1412,29 @@ void MainWindow::openFile(QString filename) {
     ts->current.document = document;
     ts->current.activeSurface = activeSurface;
 //    ts->current.activeSurfaceThreshold = 1.0E-02;
+    if (!document.activeSurface.isEmpty())
+    {
+        ts->current.activeSurfaceThreshold = document.activeSurfaceThreshold;
+        ts->current.activeSurfaceEnclosedFraction = document.activeSurfaceEnclosedFraction;
+        ts->current.activeSurfaceProperty = document.activeSurfaceProperty;
+        ts->current.activeSurfaceHasRegion = document.activeSurfaceHasRegion;
+        ts->current.activeSurfaceRegionMin = document.activeSurfaceRegionMin;
+        ts->current.activeSurfaceRegionMax = document.activeSurfaceRegionMax;
+        ts->current.activeSurfaceClipPlane = document.activeSurfaceClipPlane;
+    }
     ts->current.calculation = loadedOpt;
+
+    // Saved meshes go straight to the cache, so showing them doesn't need the volume loaded.
+    // Their mode includes the region, so they match activeSurfaceKey() once the state is restored.
+    for (auto const &surface: document.surfaceMeshes)
+    {
+        IsosurfaceCache::Key key {document.volumes.value(surface.volume).id(), surface.threshold, surface.mode,
+                                  document.volumes.value(surface.property).id()};
+        ts->surfaceCache->insert(key, surface.mesh);
+        if (surface.volume == document.activeSurface && document.activeSurfaceEnclosedFraction > 0.0f)
+            ts->surfaceCache->insertThreshold(key.volumeId, document.activeSurfaceEnclosedFraction, surface.threshold);
+    }
+    ts->current.document.surfaceMeshes.clear();
     ts->filePath = filename;
 
     if (emptyMolecule)
@@ -40,6 +40,9 @@ public slots:
     void actionStyleBallandStick();
     void actionStyleStick();
     void actionShowInfo();
+    // Limit the surface to a box around the selected atoms, or clip it at their plane
+    void actionSurfaceRegion(bool checked);
+    void actionSurfaceClip(bool checked);
 
     void actionConfigureNWChem();
     void actionNWChemOptimize();
@@ -52,7 +55,12 @@ public slots:
     void toolButtonClicked(QAbstractButton *button);
     void cleanUpButtonClicked();
 
-    void generateNWChemSurface(QString name, float threshold);
+    void generateNWChemSurface(QString name, float threshold, float enclosedFraction = 0.0f);
+    // Change the isovalue of the current and future surfaces, if enclosedFraction is nonzero
+    // the isovalue is chosen from each volume's statistics instead of using threshold.
+    void setSurfaceIsovalue(float threshold, float enclosedFraction = 0.0f);
+    // Color the current and future surfaces by the values of another volume, empty for none
+    void setSurfaceProperty(QString name);
     void animateFrequency(int index);
 
 private:
@@ -35,6 +35,8 @@
 #include <QDebugOverlay>
 #include <QFrameAction>
 #include <QElapsedTimer>
+#include <QThreadPool>
+#include <QtConcurrentRun>
 #include <cmath>
 #include <QPointLight>
 
@@ -135,7 +137,10 @@ struct BondListEntry {
 class Mol3dViewPrivate
 {
 public:
-    Mol3dViewPrivate(Mol3dView *q) : q_ptr(q) {}
+    Mol3dViewPrivate(Mol3dView *q) : q_ptr(q)
+    {
+        surfacePool.setMaxThreadCount(1);
+    }
 
     Mol3dView * const q_ptr;
     Q_DECLARE_PUBLIC(Mol3dView)
@@ -164,7 +169,12 @@ public:
 
     MolStruct currentStructure;
 
-    Qt3DCore::QEntity *currentSurface = nullptr;
+    IsosurfaceEntity *currentSurface = nullptr;
+    // Surfaces are built one at a time on their own pool, a new request cancels the
+    // running one and results from older generations are dropped
+    QThreadPool surfacePool;
+    int surfaceGeneration = 0;
+    std::shared_ptr<std::atomic<bool>> surfaceCancel;
 
     QElapsedTimer animationTimer;
     QVector<QVector3D> animationEigenvector;
@@ -191,6 +201,9 @@ public:
 
     void initScene();
     void clearScene();
+    void cancelSurface();
+    void removeSurface();
+    void setSurfaceMesh(IsosurfaceMesh const &mesh);
 
     void rotate(float pitch, float yaw);
     void updateCamera();
@@ -281,6 +294,43 @@ void Mol3dViewPrivate::initScene()
     view->setActiveFrameGraph(surfaceSelector);
 }
 
+void Mol3dViewPrivate::cancelSurface()
+{
+    Q_Q(Mol3dView);
+    if (surfaceCancel)
+    {
+        *surfaceCancel = true;
+        surfaceCancel = nullptr;
+        emit q->surfaceProgress(100);
+    }
+    surfaceGeneration++;
+}
+
+void Mol3dViewPrivate::removeSurface()
+{
+    if (currentSurface)
+    {
+        delete currentSurface;
+        currentSurface = nullptr;
+    }
+    cancelSurface();
+}
+
+void Mol3dViewPrivate::setSurfaceMesh(IsosurfaceMesh const &mesh)
+{
+    if (currentSurface)
+    {
+        currentSurface->setMesh(mesh);
+        return;
+    }
+
+    currentSurface = IsosurfaceEntity::fromMesh(mesh, QColor::fromRgbF(0.3f, 0.3f, 0.7f, 0.5f),
+                                                QColor::fromRgbF(0.7f, 0.3f, 0.3f, 0.5f));
+    currentSurface->addComponent(transparentRenderLayer);
+    currentSurface->negativeLobe->addComponent(transparentRenderLayer);
+    currentSurface->setParent(structureEntity);
+}
+
 void Mol3dViewPrivate::clearScene()
 {
     clearSelection();
@@ -291,6 +341,7 @@ void Mol3dViewPrivate::clearScene()
     currentStructure = {};
     hoverEntity = nullptr;
     currentSurface = nullptr;
+    cancelSurface();
     animationEigenvector = {};
 
     delete structureEntity;
@@ -642,6 +693,10 @@ Mol3dView::Mol3dView(QWidget *parent) : QWidget(parent),
 
 Mol3dView::~Mol3dView()
 {
+    Q_D(Mol3dView);
+    // The surface job posts its results to this object, so it must finish first
+    d->cancelSurface();
+    d->surfacePool.waitForDone();
 }
 
 bool Mol3dView::eventFilter(QObject *obj, QEvent *event)
@@ -1164,22 +1219,129 @@ void Mol3dView::showMolStruct(const MolStruct &ms)
     emit moleculeChanged();
 }
 
-void Mol3dView::showVolumeData(VolumeData const &vol, float threshold)
+void Mol3dView::showVolumeData(VolumeData const &vol, float threshold, std::function<void(IsosurfaceMesh const &)> finished,
+                               VolumeData const &property, IsosurfaceOptions const &buildOptions)
 {
-    Q_D(Mol3dView);
-    if (d->currentSurface)
+    if (!vol.size())
     {
-        delete d->currentSurface;
-        d->currentSurface = nullptr;
+        Q_D(Mol3dView);
+        d->cancelSurface();
+        d->removeSurface();
+        d->updateCamera();
+        return;
     }
 
-    if (!vol.data.isEmpty())
-    {
-        d->currentSurface = IsosurfaceEntity::fromData(vol, QColor::fromRgbF(0.3f, 0.3f, 0.7f, 0.5f), threshold);
-        d->currentSurface->addComponent(d->transparentRenderLayer);
-        d->currentSurface->setParent(d->structureEntity);
-    }
+    showVolumeData([vol, threshold, property]() { return SurfaceSource{vol, threshold, property}; },
+                   [finished](IsosurfaceMesh const &mesh, float) {
+                       if (finished)
+                           finished(mesh);
+                   }, buildOptions);
+}
 
+void Mol3dView::showVolumeData(std::function<SurfaceSource()> prepare,
+                               std::function<void(IsosurfaceMesh const &, float)> finished,
+                               IsosurfaceOptions const &buildOptions)
+{
+    Q_D(Mol3dView);
+    // The current surface stays visible until the new one is ready, so dragging the
+    // isovalue doesn't flicker
+    d->cancelSurface();
+    d->updateCamera();
+
+    const int generation = d->surfaceGeneration;
+    IsosurfaceOptions options = buildOptions;
+    options.cancel = d->surfaceCancel = std::make_shared<std::atomic<bool>>(false);
+
+    auto deliver = [this, generation, finished](IsosurfaceMesh const &mesh, float threshold, bool final) {
+        QMetaObject::invokeMethod(this, [this, generation, finished, mesh, threshold, final]() {
+            Q_D(Mol3dView);
+            // Drop the result if a different surface has been shown since
+            if (generation != d->surfaceGeneration)
+                return;
+            d->setSurfaceMesh(mesh);
+            if (final && finished)
+                finished(mesh, threshold);
+        }, Qt::QueuedConnection);
+    };
+
+    auto remove = [this, generation]() {
+        QMetaObject::invokeMethod(this, [this, generation]() {
+            Q_D(Mol3dView);
+            if (generation != d->surfaceGeneration)
+                return;
+            d->removeSurface();
+            d->updateCamera();
+        }, Qt::QueuedConnection);
+    };
+
+    auto reportProgress = [this, generation](int percent) {
+        QMetaObject::invokeMethod(this, [this, generation, percent]() {
+            Q_D(Mol3dView);
+            if (generation == d->surfaceGeneration)
+                emit surfaceProgress(percent);
+        }, Qt::QueuedConnection);
+    };
+
+    QtConcurrent::run(&d->surfacePool, [prepare, options, deliver, remove, reportProgress]() mutable {
+        // Requests that were replaced while waiting for the pool are skipped entirely
+        if (*options.cancel)
+            return;
+
+        SurfaceSource source = prepare();
+        if (*options.cancel)
+            return;
+
+        VolumeData const &vol = source.volume;
+        const float threshold = source.threshold;
+        if (!vol.size())
+        {
+            remove();
+            return;
+        }
+
+        // Large volumes are first shown at a reduced resolution while the full
+        // resolution surface is built, with its progress shown in the status bar.
+        const qint64 previewPoints = 1 << 18;
+        int level = 0;
+        while (qint64(vol.xDim >> level) * (vol.yDim >> level) * (vol.zDim >> level) > previewPoints)
+            level++;
+
+        // Orbitals are shown with both lobes, colored by their sign. The sign comes from the brick
+        // index each build uses anyway, a statistics pass would read every point before the preview.
+        if (level > 0)
+        {
+            reportProgress(0);
+            VolumeData previewVolume = vol.downsampled(level);
+            IsosurfaceOptions previewOptions = options;
+            previewOptions.dual = threshold > 0.0f && previewVolume.brickIndex().isSigned();
+            IsosurfaceMesh preview = IsosurfaceMesh::build(previewVolume, threshold, previewOptions);
+            if (*options.cancel)
+                return;
+            if (source.property.size())
+                preview.mapProperty(source.property, options.threadCount);
+            deliver(preview, threshold, false);
+            options.progress = reportProgress;
+        }
+
+        options.dual = threshold > 0.0f && vol.brickIndex().isSigned();
+        IsosurfaceMesh mesh = IsosurfaceMesh::build(vol, threshold, options);
+        if (*options.cancel)
+            return;
+        if (source.property.size())
+            mesh.mapProperty(source.property, options.threadCount);
+        deliver(mesh, threshold, true);
+        if (level > 0)
+            reportProgress(100);
+    });
+}
+
+void Mol3dView::showSurfaceMesh(IsosurfaceMesh const &mesh)
+{
+    Q_D(Mol3dView);
+    // A surface still being built mustn't replace this one when it finishes
+    d->cancelSurface();
+    d->removeSurface();
+    d->setSurfaceMesh(mesh);
     d->updateCamera();
 }
 
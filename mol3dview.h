@@ -3,8 +3,10 @@
 
 #include "molstruct.h"
 #include "volumedata.h"
+#include "isosurfacemesh.h"
 
 #include <QWidget>
+#include <functional>
 
 class Mol3dViewPrivate;
 class Mol3dView : public QWidget
@@ -18,7 +20,27 @@ public:
     QWindow *getViewWindow();
 
     void showMolStruct(const MolStruct &ms);
-    void showVolumeData(const VolumeData &vol, float threshold = 0.0f);
+    // The surface is built in the background, finished is then called on this thread with the
+    // full resolution mesh unless it was replaced by another surface in the meantime. If
+    // property isn't empty the surface is colored by its values at each vertex.
+    void showVolumeData(const VolumeData &vol, float threshold = 0.0f,
+                        std::function<void(IsosurfaceMesh const &)> finished = nullptr,
+                        const VolumeData &property = VolumeData(),
+                        const IsosurfaceOptions &buildOptions = IsosurfaceOptions::fromSettings());
+    // What a surface is built from, see the showVolumeData() overload below
+    struct SurfaceSource {
+        VolumeData volume;
+        float threshold = 0.0f;
+        VolumeData property;
+    };
+    // Like showVolumeData(), but prepare runs on the surface thread before the build, so loading
+    // or cropping the volumes doesn't block this thread. finished also receives the threshold
+    // prepare chose. An empty volume removes the surface.
+    void showVolumeData(std::function<SurfaceSource()> prepare,
+                        std::function<void(IsosurfaceMesh const &, float threshold)> finished,
+                        const IsosurfaceOptions &buildOptions = IsosurfaceOptions::fromSettings());
+    // Show an already built surface
+    void showSurfaceMesh(IsosurfaceMesh const &mesh);
     void showAnimation(QVector<QVector3D> eigenvector, float intensity);
 
     MolStruct getMolStruct();
@@ -60,6 +82,8 @@ signals:
     void moleculeChanged();
     void selectionChanged(Selection s);
     void hoverInfo(QString info);
+    // While a large surface is built in the background, 100 once it's done or replaced
+    void surfaceProgress(int percent);
 
 private:
     QScopedPointer<Mol3dViewPrivate> const d_ptr;
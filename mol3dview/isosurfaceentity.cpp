@@ -1,13 +1,21 @@
 #include "mol3dview/isosurfaceentity.h"
 
-#include <array>
 #include <QEffect>
 #include <QTechnique>
 #include <QPointSize>
 #include <QAttribute>
+#include <QBlendEquation>
+#include <QBlendEquationArguments>
+#include <QFilterKey>
 #include <QGeometry>
-#include <QtCore/QBuffer>
+#include <QGraphicsApiFilter>
+#include <QNoDepthMask>
+#include <QRenderPass>
+#include <QShaderProgram>
+#include <QUrl>
 #include <QDebug>
+#include <algorithm>
+#include <cmath>
 
 
 #if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
@@ -16,501 +24,62 @@
 #include <Qt3DRender/QBuffer>
 #endif
 
-/* Marching cubes code from originally from http://paulbourke.net/geometry/polygonise/ */
-namespace  {
-
-class Point3I
+namespace {
+Qt3DCompat::QAttribute *vertexAttribute(QString const &name, int byteOffset, Qt3DCompat::QBuffer *buffer, Qt3DCore::QNode *parent)
 {
-public:
-    Point3I() : Point3I(0,0,0) {}
-    Point3I(int x, int y, int z) : x(x), y(y), z(z) {}
-    int x;
-    int y;
-    int z;
-
-    bool operator<( Point3I const & rhs ) const
-    {
-        if (x < rhs.x)
-            return true;
-        if (y < rhs.y)
-            return true;
-        if (z < rhs.z)
-            return true;
-        return false;
-    }
-
-    bool operator==( Point3I const & rhs ) const
-    {
-        if ((x == rhs.x) && (y == rhs.y) && (z == rhs.z))
-            return true;
-        return false;
-    }
-
-    QVector3D toQVector3D() { return QVector3D(x,y,z); }
-};
-
-class MeshBuilder
-{
-public:
-    struct Gridcell {
-        std::array<Point3I, 8> p;
-        std::array<double, 8> val;
-    };
-
-    struct Triangle {
-        std::array<int, 3> p;
-    };
-
-    void build(const VolumeData &volume, float threshold);
-    void processCell(const Gridcell &grid, double isolevel);
-    int vertexInterp(float isolevel, Point3I p1, Point3I p2, float valp1, float valp2);
-
-    QVector<QVector3D> vertexList;
-    QVector<QVector3D> normalList;
-    QMap<std::array<int, 6>, int> vertexCache;
-    QVector<Triangle> triangles;
-};
-
-void MeshBuilder::build(const VolumeData &volume, float threshold)
-{
-    for (int x = 0; x < volume.xDim - 1; x++)
-    {
-        for (int y = 0; y < volume.yDim - 1; y++)
-        {
-            for (int z = 0; z < volume.zDim - 1; z++)
-            {
-                Gridcell grid;
-                grid.p[0] = Point3I(x,   y,   z);
-                grid.p[1] = Point3I(x+1, y,   z);
-                grid.p[2] = Point3I(x+1, y+1, z);
-                grid.p[3] = Point3I(x,   y+1, z);
-                grid.p[4] = Point3I(x,   y,   z+1);
-                grid.p[5] = Point3I(x+1, y,   z+1);
-                grid.p[6] = Point3I(x+1, y+1, z+1);
-                grid.p[7] = Point3I(x,   y+1, z+1);
-
-                int idx = 0;
-                for (const auto &p: grid.p)
-                    grid.val[idx++] = volume.getAt(p.x, p.y, p.z);
-
-                processCell(grid, threshold);
-            }
-        }
-    }
-
-    for (auto &coord: vertexList)
-        coord = volume.transform.map(coord);
-
-    // Generate smooth vertex normals by averaging the face normals of
-    // all triangles sharing the vertex.
-    // TODO: The original source of this code mentions doing a weighted
-    //       average based on the size of the trangle my provide better
-    //       results.
-    normalList.resize(vertexList.size());
-    for (auto &triangle: triangles)
-    {
-        auto p0 = vertexList[triangle.p[0]];
-        auto p1 = vertexList[triangle.p[1]];
-        auto p2 = vertexList[triangle.p[2]];
-
-        QVector3D surfaceNormal = QVector3D::normal(p1 - p0, p2 - p0);
-        normalList[triangle.p[0]] += surfaceNormal;
-        normalList[triangle.p[1]] += surfaceNormal;
-        normalList[triangle.p[2]] += surfaceNormal;
-    }
-
-    for (auto &normal: normalList)
-        normal.normalize();
+    auto attr = new Qt3DCompat::QAttribute(parent);
+    attr->setName(name);
+    attr->setVertexBaseType(Qt3DCompat::QAttribute::Float);
+    attr->setVertexSize(3);
+    attr->setAttributeType(Qt3DCompat::QAttribute::VertexAttribute);
+    attr->setBuffer(buffer);
+    attr->setByteStride(IsosurfaceMesh::vertexStride);
+    attr->setByteOffset(byteOffset);
+    attr->setCount(0);
+    return attr;
 }
 
-/* Given a grid cell and an isolevel, calculate the triangular
- * facets required to represent the isosurface through the cell. */
-void MeshBuilder::processCell(Gridcell const &grid, double isolevel)
+Qt3DCompat::QAttribute *floatAttribute(QString const &name, int size, Qt3DCompat::QBuffer *buffer, Qt3DCore::QNode *parent)
 {
-    static const int edgeTable[256] = {
-        0x0  , 0x109, 0x203, 0x30a, 0x406, 0x50f, 0x605, 0x70c,
-        0x80c, 0x905, 0xa0f, 0xb06, 0xc0a, 0xd03, 0xe09, 0xf00,
-        0x190, 0x99 , 0x393, 0x29a, 0x596, 0x49f, 0x795, 0x69c,
-        0x99c, 0x895, 0xb9f, 0xa96, 0xd9a, 0xc93, 0xf99, 0xe90,
-        0x230, 0x339, 0x33 , 0x13a, 0x636, 0x73f, 0x435, 0x53c,
-        0xa3c, 0xb35, 0x83f, 0x936, 0xe3a, 0xf33, 0xc39, 0xd30,
-        0x3a0, 0x2a9, 0x1a3, 0xaa , 0x7a6, 0x6af, 0x5a5, 0x4ac,
-        0xbac, 0xaa5, 0x9af, 0x8a6, 0xfaa, 0xea3, 0xda9, 0xca0,
-        0x460, 0x569, 0x663, 0x76a, 0x66 , 0x16f, 0x265, 0x36c,
-        0xc6c, 0xd65, 0xe6f, 0xf66, 0x86a, 0x963, 0xa69, 0xb60,
-        0x5f0, 0x4f9, 0x7f3, 0x6fa, 0x1f6, 0xff , 0x3f5, 0x2fc,
-        0xdfc, 0xcf5, 0xfff, 0xef6, 0x9fa, 0x8f3, 0xbf9, 0xaf0,
-        0x650, 0x759, 0x453, 0x55a, 0x256, 0x35f, 0x55 , 0x15c,
-        0xe5c, 0xf55, 0xc5f, 0xd56, 0xa5a, 0xb53, 0x859, 0x950,
-        0x7c0, 0x6c9, 0x5c3, 0x4ca, 0x3c6, 0x2cf, 0x1c5, 0xcc ,
-        0xfcc, 0xec5, 0xdcf, 0xcc6, 0xbca, 0xac3, 0x9c9, 0x8c0,
-        0x8c0, 0x9c9, 0xac3, 0xbca, 0xcc6, 0xdcf, 0xec5, 0xfcc,
-        0xcc , 0x1c5, 0x2cf, 0x3c6, 0x4ca, 0x5c3, 0x6c9, 0x7c0,
-        0x950, 0x859, 0xb53, 0xa5a, 0xd56, 0xc5f, 0xf55, 0xe5c,
-        0x15c, 0x55 , 0x35f, 0x256, 0x55a, 0x453, 0x759, 0x650,
-        0xaf0, 0xbf9, 0x8f3, 0x9fa, 0xef6, 0xfff, 0xcf5, 0xdfc,
-        0x2fc, 0x3f5, 0xff , 0x1f6, 0x6fa, 0x7f3, 0x4f9, 0x5f0,
-        0xb60, 0xa69, 0x963, 0x86a, 0xf66, 0xe6f, 0xd65, 0xc6c,
-        0x36c, 0x265, 0x16f, 0x66 , 0x76a, 0x663, 0x569, 0x460,
-        0xca0, 0xda9, 0xea3, 0xfaa, 0x8a6, 0x9af, 0xaa5, 0xbac,
-        0x4ac, 0x5a5, 0x6af, 0x7a6, 0xaa , 0x1a3, 0x2a9, 0x3a0,
-        0xd30, 0xc39, 0xf33, 0xe3a, 0x936, 0x83f, 0xb35, 0xa3c,
-        0x53c, 0x435, 0x73f, 0x636, 0x13a, 0x33 , 0x339, 0x230,
-        0xe90, 0xf99, 0xc93, 0xd9a, 0xa96, 0xb9f, 0x895, 0x99c,
-        0x69c, 0x795, 0x49f, 0x596, 0x29a, 0x393, 0x99 , 0x190,
-        0xf00, 0xe09, 0xd03, 0xc0a, 0xb06, 0xa0f, 0x905, 0x80c,
-        0x70c, 0x605, 0x50f, 0x406, 0x30a, 0x203, 0x109, 0x0};
-
-    static const int triTable[256][16] = {
-        {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {0, 8, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {0, 1, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {1, 8, 3, 9, 8, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {1, 2, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {0, 8, 3, 1, 2, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {9, 2, 10, 0, 2, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {2, 8, 3, 2, 10, 8, 10, 9, 8, -1, -1, -1, -1, -1, -1, -1},
-        {3, 11, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {0, 11, 2, 8, 11, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {1, 9, 0, 2, 3, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {1, 11, 2, 1, 9, 11, 9, 8, 11, -1, -1, -1, -1, -1, -1, -1},
-        {3, 10, 1, 11, 10, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {0, 10, 1, 0, 8, 10, 8, 11, 10, -1, -1, -1, -1, -1, -1, -1},
-        {3, 9, 0, 3, 11, 9, 11, 10, 9, -1, -1, -1, -1, -1, -1, -1},
-        {9, 8, 10, 10, 8, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {4, 7, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {4, 3, 0, 7, 3, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {0, 1, 9, 8, 4, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {4, 1, 9, 4, 7, 1, 7, 3, 1, -1, -1, -1, -1, -1, -1, -1},
-        {1, 2, 10, 8, 4, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {3, 4, 7, 3, 0, 4, 1, 2, 10, -1, -1, -1, -1, -1, -1, -1},
-        {9, 2, 10, 9, 0, 2, 8, 4, 7, -1, -1, -1, -1, -1, -1, -1},
-        {2, 10, 9, 2, 9, 7, 2, 7, 3, 7, 9, 4, -1, -1, -1, -1},
-        {8, 4, 7, 3, 11, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {11, 4, 7, 11, 2, 4, 2, 0, 4, -1, -1, -1, -1, -1, -1, -1},
-        {9, 0, 1, 8, 4, 7, 2, 3, 11, -1, -1, -1, -1, -1, -1, -1},
-        {4, 7, 11, 9, 4, 11, 9, 11, 2, 9, 2, 1, -1, -1, -1, -1},
-        {3, 10, 1, 3, 11, 10, 7, 8, 4, -1, -1, -1, -1, -1, -1, -1},
-        {1, 11, 10, 1, 4, 11, 1, 0, 4, 7, 11, 4, -1, -1, -1, -1},
-        {4, 7, 8, 9, 0, 11, 9, 11, 10, 11, 0, 3, -1, -1, -1, -1},
-        {4, 7, 11, 4, 11, 9, 9, 11, 10, -1, -1, -1, -1, -1, -1, -1},
-        {9, 5, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {9, 5, 4, 0, 8, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {0, 5, 4, 1, 5, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {8, 5, 4, 8, 3, 5, 3, 1, 5, -1, -1, -1, -1, -1, -1, -1},
-        {1, 2, 10, 9, 5, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {3, 0, 8, 1, 2, 10, 4, 9, 5, -1, -1, -1, -1, -1, -1, -1},
-        {5, 2, 10, 5, 4, 2, 4, 0, 2, -1, -1, -1, -1, -1, -1, -1},
-        {2, 10, 5, 3, 2, 5, 3, 5, 4, 3, 4, 8, -1, -1, -1, -1},
-        {9, 5, 4, 2, 3, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {0, 11, 2, 0, 8, 11, 4, 9, 5, -1, -1, -1, -1, -1, -1, -1},
-        {0, 5, 4, 0, 1, 5, 2, 3, 11, -1, -1, -1, -1, -1, -1, -1},
-        {2, 1, 5, 2, 5, 8, 2, 8, 11, 4, 8, 5, -1, -1, -1, -1},
-        {10, 3, 11, 10, 1, 3, 9, 5, 4, -1, -1, -1, -1, -1, -1, -1},
-        {4, 9, 5, 0, 8, 1, 8, 10, 1, 8, 11, 10, -1, -1, -1, -1},
-        {5, 4, 0, 5, 0, 11, 5, 11, 10, 11, 0, 3, -1, -1, -1, -1},
-        {5, 4, 8, 5, 8, 10, 10, 8, 11, -1, -1, -1, -1, -1, -1, -1},
-        {9, 7, 8, 5, 7, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {9, 3, 0, 9, 5, 3, 5, 7, 3, -1, -1, -1, -1, -1, -1, -1},
-        {0, 7, 8, 0, 1, 7, 1, 5, 7, -1, -1, -1, -1, -1, -1, -1},
-        {1, 5, 3, 3, 5, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {9, 7, 8, 9, 5, 7, 10, 1, 2, -1, -1, -1, -1, -1, -1, -1},
-        {10, 1, 2, 9, 5, 0, 5, 3, 0, 5, 7, 3, -1, -1, -1, -1},
-        {8, 0, 2, 8, 2, 5, 8, 5, 7, 10, 5, 2, -1, -1, -1, -1},
-        {2, 10, 5, 2, 5, 3, 3, 5, 7, -1, -1, -1, -1, -1, -1, -1},
-        {7, 9, 5, 7, 8, 9, 3, 11, 2, -1, -1, -1, -1, -1, -1, -1},
-        {9, 5, 7, 9, 7, 2, 9, 2, 0, 2, 7, 11, -1, -1, -1, -1},
-        {2, 3, 11, 0, 1, 8, 1, 7, 8, 1, 5, 7, -1, -1, -1, -1},
-        {11, 2, 1, 11, 1, 7, 7, 1, 5, -1, -1, -1, -1, -1, -1, -1},
-        {9, 5, 8, 8, 5, 7, 10, 1, 3, 10, 3, 11, -1, -1, -1, -1},
-        {5, 7, 0, 5, 0, 9, 7, 11, 0, 1, 0, 10, 11, 10, 0, -1},
-        {11, 10, 0, 11, 0, 3, 10, 5, 0, 8, 0, 7, 5, 7, 0, -1},
-        {11, 10, 5, 7, 11, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {10, 6, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {0, 8, 3, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {9, 0, 1, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {1, 8, 3, 1, 9, 8, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1},
-        {1, 6, 5, 2, 6, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {1, 6, 5, 1, 2, 6, 3, 0, 8, -1, -1, -1, -1, -1, -1, -1},
-        {9, 6, 5, 9, 0, 6, 0, 2, 6, -1, -1, -1, -1, -1, -1, -1},
-        {5, 9, 8, 5, 8, 2, 5, 2, 6, 3, 2, 8, -1, -1, -1, -1},
-        {2, 3, 11, 10, 6, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {11, 0, 8, 11, 2, 0, 10, 6, 5, -1, -1, -1, -1, -1, -1, -1},
-        {0, 1, 9, 2, 3, 11, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1},
-        {5, 10, 6, 1, 9, 2, 9, 11, 2, 9, 8, 11, -1, -1, -1, -1},
-        {6, 3, 11, 6, 5, 3, 5, 1, 3, -1, -1, -1, -1, -1, -1, -1},
-        {0, 8, 11, 0, 11, 5, 0, 5, 1, 5, 11, 6, -1, -1, -1, -1},
-        {3, 11, 6, 0, 3, 6, 0, 6, 5, 0, 5, 9, -1, -1, -1, -1},
-        {6, 5, 9, 6, 9, 11, 11, 9, 8, -1, -1, -1, -1, -1, -1, -1},
-        {5, 10, 6, 4, 7, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {4, 3, 0, 4, 7, 3, 6, 5, 10, -1, -1, -1, -1, -1, -1, -1},
-        {1, 9, 0, 5, 10, 6, 8, 4, 7, -1, -1, -1, -1, -1, -1, -1},
-        {10, 6, 5, 1, 9, 7, 1, 7, 3, 7, 9, 4, -1, -1, -1, -1},
-        {6, 1, 2, 6, 5, 1, 4, 7, 8, -1, -1, -1, -1, -1, -1, -1},
-        {1, 2, 5, 5, 2, 6, 3, 0, 4, 3, 4, 7, -1, -1, -1, -1},
-        {8, 4, 7, 9, 0, 5, 0, 6, 5, 0, 2, 6, -1, -1, -1, -1},
-        {7, 3, 9, 7, 9, 4, 3, 2, 9, 5, 9, 6, 2, 6, 9, -1},
-        {3, 11, 2, 7, 8, 4, 10, 6, 5, -1, -1, -1, -1, -1, -1, -1},
-        {5, 10, 6, 4, 7, 2, 4, 2, 0, 2, 7, 11, -1, -1, -1, -1},
-        {0, 1, 9, 4, 7, 8, 2, 3, 11, 5, 10, 6, -1, -1, -1, -1},
-        {9, 2, 1, 9, 11, 2, 9, 4, 11, 7, 11, 4, 5, 10, 6, -1},
-        {8, 4, 7, 3, 11, 5, 3, 5, 1, 5, 11, 6, -1, -1, -1, -1},
-        {5, 1, 11, 5, 11, 6, 1, 0, 11, 7, 11, 4, 0, 4, 11, -1},
-        {0, 5, 9, 0, 6, 5, 0, 3, 6, 11, 6, 3, 8, 4, 7, -1},
-        {6, 5, 9, 6, 9, 11, 4, 7, 9, 7, 11, 9, -1, -1, -1, -1},
-        {10, 4, 9, 6, 4, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {4, 10, 6, 4, 9, 10, 0, 8, 3, -1, -1, -1, -1, -1, -1, -1},
-        {10, 0, 1, 10, 6, 0, 6, 4, 0, -1, -1, -1, -1, -1, -1, -1},
-        {8, 3, 1, 8, 1, 6, 8, 6, 4, 6, 1, 10, -1, -1, -1, -1},
-        {1, 4, 9, 1, 2, 4, 2, 6, 4, -1, -1, -1, -1, -1, -1, -1},
-        {3, 0, 8, 1, 2, 9, 2, 4, 9, 2, 6, 4, -1, -1, -1, -1},
-        {0, 2, 4, 4, 2, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {8, 3, 2, 8, 2, 4, 4, 2, 6, -1, -1, -1, -1, -1, -1, -1},
-        {10, 4, 9, 10, 6, 4, 11, 2, 3, -1, -1, -1, -1, -1, -1, -1},
-        {0, 8, 2, 2, 8, 11, 4, 9, 10, 4, 10, 6, -1, -1, -1, -1},
-        {3, 11, 2, 0, 1, 6, 0, 6, 4, 6, 1, 10, -1, -1, -1, -1},
-        {6, 4, 1, 6, 1, 10, 4, 8, 1, 2, 1, 11, 8, 11, 1, -1},
-        {9, 6, 4, 9, 3, 6, 9, 1, 3, 11, 6, 3, -1, -1, -1, -1},
-        {8, 11, 1, 8, 1, 0, 11, 6, 1, 9, 1, 4, 6, 4, 1, -1},
-        {3, 11, 6, 3, 6, 0, 0, 6, 4, -1, -1, -1, -1, -1, -1, -1},
-        {6, 4, 8, 11, 6, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {7, 10, 6, 7, 8, 10, 8, 9, 10, -1, -1, -1, -1, -1, -1, -1},
-        {0, 7, 3, 0, 10, 7, 0, 9, 10, 6, 7, 10, -1, -1, -1, -1},
-        {10, 6, 7, 1, 10, 7, 1, 7, 8, 1, 8, 0, -1, -1, -1, -1},
-        {10, 6, 7, 10, 7, 1, 1, 7, 3, -1, -1, -1, -1, -1, -1, -1},
-        {1, 2, 6, 1, 6, 8, 1, 8, 9, 8, 6, 7, -1, -1, -1, -1},
-        {2, 6, 9, 2, 9, 1, 6, 7, 9, 0, 9, 3, 7, 3, 9, -1},
-        {7, 8, 0, 7, 0, 6, 6, 0, 2, -1, -1, -1, -1, -1, -1, -1},
-        {7, 3, 2, 6, 7, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {2, 3, 11, 10, 6, 8, 10, 8, 9, 8, 6, 7, -1, -1, -1, -1},
-        {2, 0, 7, 2, 7, 11, 0, 9, 7, 6, 7, 10, 9, 10, 7, -1},
-        {1, 8, 0, 1, 7, 8, 1, 10, 7, 6, 7, 10, 2, 3, 11, -1},
-        {11, 2, 1, 11, 1, 7, 10, 6, 1, 6, 7, 1, -1, -1, -1, -1},
-        {8, 9, 6, 8, 6, 7, 9, 1, 6, 11, 6, 3, 1, 3, 6, -1},
-        {0, 9, 1, 11, 6, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {7, 8, 0, 7, 0, 6, 3, 11, 0, 11, 6, 0, -1, -1, -1, -1},
-        {7, 11, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {7, 6, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {3, 0, 8, 11, 7, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {0, 1, 9, 11, 7, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {8, 1, 9, 8, 3, 1, 11, 7, 6, -1, -1, -1, -1, -1, -1, -1},
-        {10, 1, 2, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {1, 2, 10, 3, 0, 8, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1},
-        {2, 9, 0, 2, 10, 9, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1},
-        {6, 11, 7, 2, 10, 3, 10, 8, 3, 10, 9, 8, -1, -1, -1, -1},
-        {7, 2, 3, 6, 2, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {7, 0, 8, 7, 6, 0, 6, 2, 0, -1, -1, -1, -1, -1, -1, -1},
-        {2, 7, 6, 2, 3, 7, 0, 1, 9, -1, -1, -1, -1, -1, -1, -1},
-        {1, 6, 2, 1, 8, 6, 1, 9, 8, 8, 7, 6, -1, -1, -1, -1},
-        {10, 7, 6, 10, 1, 7, 1, 3, 7, -1, -1, -1, -1, -1, -1, -1},
-        {10, 7, 6, 1, 7, 10, 1, 8, 7, 1, 0, 8, -1, -1, -1, -1},
-        {0, 3, 7, 0, 7, 10, 0, 10, 9, 6, 10, 7, -1, -1, -1, -1},
-        {7, 6, 10, 7, 10, 8, 8, 10, 9, -1, -1, -1, -1, -1, -1, -1},
-        {6, 8, 4, 11, 8, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {3, 6, 11, 3, 0, 6, 0, 4, 6, -1, -1, -1, -1, -1, -1, -1},
-        {8, 6, 11, 8, 4, 6, 9, 0, 1, -1, -1, -1, -1, -1, -1, -1},
-        {9, 4, 6, 9, 6, 3, 9, 3, 1, 11, 3, 6, -1, -1, -1, -1},
-        {6, 8, 4, 6, 11, 8, 2, 10, 1, -1, -1, -1, -1, -1, -1, -1},
-        {1, 2, 10, 3, 0, 11, 0, 6, 11, 0, 4, 6, -1, -1, -1, -1},
-        {4, 11, 8, 4, 6, 11, 0, 2, 9, 2, 10, 9, -1, -1, -1, -1},
-        {10, 9, 3, 10, 3, 2, 9, 4, 3, 11, 3, 6, 4, 6, 3, -1},
-        {8, 2, 3, 8, 4, 2, 4, 6, 2, -1, -1, -1, -1, -1, -1, -1},
-        {0, 4, 2, 4, 6, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {1, 9, 0, 2, 3, 4, 2, 4, 6, 4, 3, 8, -1, -1, -1, -1},
-        {1, 9, 4, 1, 4, 2, 2, 4, 6, -1, -1, -1, -1, -1, -1, -1},
-        {8, 1, 3, 8, 6, 1, 8, 4, 6, 6, 10, 1, -1, -1, -1, -1},
-        {10, 1, 0, 10, 0, 6, 6, 0, 4, -1, -1, -1, -1, -1, -1, -1},
-        {4, 6, 3, 4, 3, 8, 6, 10, 3, 0, 3, 9, 10, 9, 3, -1},
-        {10, 9, 4, 6, 10, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {4, 9, 5, 7, 6, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {0, 8, 3, 4, 9, 5, 11, 7, 6, -1, -1, -1, -1, -1, -1, -1},
-        {5, 0, 1, 5, 4, 0, 7, 6, 11, -1, -1, -1, -1, -1, -1, -1},
-        {11, 7, 6, 8, 3, 4, 3, 5, 4, 3, 1, 5, -1, -1, -1, -1},
-        {9, 5, 4, 10, 1, 2, 7, 6, 11, -1, -1, -1, -1, -1, -1, -1},
-        {6, 11, 7, 1, 2, 10, 0, 8, 3, 4, 9, 5, -1, -1, -1, -1},
-        {7, 6, 11, 5, 4, 10, 4, 2, 10, 4, 0, 2, -1, -1, -1, -1},
-        {3, 4, 8, 3, 5, 4, 3, 2, 5, 10, 5, 2, 11, 7, 6, -1},
-        {7, 2, 3, 7, 6, 2, 5, 4, 9, -1, -1, -1, -1, -1, -1, -1},
-        {9, 5, 4, 0, 8, 6, 0, 6, 2, 6, 8, 7, -1, -1, -1, -1},
-        {3, 6, 2, 3, 7, 6, 1, 5, 0, 5, 4, 0, -1, -1, -1, -1},
-        {6, 2, 8, 6, 8, 7, 2, 1, 8, 4, 8, 5, 1, 5, 8, -1},
-        {9, 5, 4, 10, 1, 6, 1, 7, 6, 1, 3, 7, -1, -1, -1, -1},
-        {1, 6, 10, 1, 7, 6, 1, 0, 7, 8, 7, 0, 9, 5, 4, -1},
-        {4, 0, 10, 4, 10, 5, 0, 3, 10, 6, 10, 7, 3, 7, 10, -1},
-        {7, 6, 10, 7, 10, 8, 5, 4, 10, 4, 8, 10, -1, -1, -1, -1},
-        {6, 9, 5, 6, 11, 9, 11, 8, 9, -1, -1, -1, -1, -1, -1, -1},
-        {3, 6, 11, 0, 6, 3, 0, 5, 6, 0, 9, 5, -1, -1, -1, -1},
-        {0, 11, 8, 0, 5, 11, 0, 1, 5, 5, 6, 11, -1, -1, -1, -1},
-        {6, 11, 3, 6, 3, 5, 5, 3, 1, -1, -1, -1, -1, -1, -1, -1},
-        {1, 2, 10, 9, 5, 11, 9, 11, 8, 11, 5, 6, -1, -1, -1, -1},
-        {0, 11, 3, 0, 6, 11, 0, 9, 6, 5, 6, 9, 1, 2, 10, -1},
-        {11, 8, 5, 11, 5, 6, 8, 0, 5, 10, 5, 2, 0, 2, 5, -1},
-        {6, 11, 3, 6, 3, 5, 2, 10, 3, 10, 5, 3, -1, -1, -1, -1},
-        {5, 8, 9, 5, 2, 8, 5, 6, 2, 3, 8, 2, -1, -1, -1, -1},
-        {9, 5, 6, 9, 6, 0, 0, 6, 2, -1, -1, -1, -1, -1, -1, -1},
-        {1, 5, 8, 1, 8, 0, 5, 6, 8, 3, 8, 2, 6, 2, 8, -1},
-        {1, 5, 6, 2, 1, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {1, 3, 6, 1, 6, 10, 3, 8, 6, 5, 6, 9, 8, 9, 6, -1},
-        {10, 1, 0, 10, 0, 6, 9, 5, 0, 5, 6, 0, -1, -1, -1, -1},
-        {0, 3, 8, 5, 6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {10, 5, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {11, 5, 10, 7, 5, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {11, 5, 10, 11, 7, 5, 8, 3, 0, -1, -1, -1, -1, -1, -1, -1},
-        {5, 11, 7, 5, 10, 11, 1, 9, 0, -1, -1, -1, -1, -1, -1, -1},
-        {10, 7, 5, 10, 11, 7, 9, 8, 1, 8, 3, 1, -1, -1, -1, -1},
-        {11, 1, 2, 11, 7, 1, 7, 5, 1, -1, -1, -1, -1, -1, -1, -1},
-        {0, 8, 3, 1, 2, 7, 1, 7, 5, 7, 2, 11, -1, -1, -1, -1},
-        {9, 7, 5, 9, 2, 7, 9, 0, 2, 2, 11, 7, -1, -1, -1, -1},
-        {7, 5, 2, 7, 2, 11, 5, 9, 2, 3, 2, 8, 9, 8, 2, -1},
-        {2, 5, 10, 2, 3, 5, 3, 7, 5, -1, -1, -1, -1, -1, -1, -1},
-        {8, 2, 0, 8, 5, 2, 8, 7, 5, 10, 2, 5, -1, -1, -1, -1},
-        {9, 0, 1, 5, 10, 3, 5, 3, 7, 3, 10, 2, -1, -1, -1, -1},
-        {9, 8, 2, 9, 2, 1, 8, 7, 2, 10, 2, 5, 7, 5, 2, -1},
-        {1, 3, 5, 3, 7, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {0, 8, 7, 0, 7, 1, 1, 7, 5, -1, -1, -1, -1, -1, -1, -1},
-        {9, 0, 3, 9, 3, 5, 5, 3, 7, -1, -1, -1, -1, -1, -1, -1},
-        {9, 8, 7, 5, 9, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {5, 8, 4, 5, 10, 8, 10, 11, 8, -1, -1, -1, -1, -1, -1, -1},
-        {5, 0, 4, 5, 11, 0, 5, 10, 11, 11, 3, 0, -1, -1, -1, -1},
-        {0, 1, 9, 8, 4, 10, 8, 10, 11, 10, 4, 5, -1, -1, -1, -1},
-        {10, 11, 4, 10, 4, 5, 11, 3, 4, 9, 4, 1, 3, 1, 4, -1},
-        {2, 5, 1, 2, 8, 5, 2, 11, 8, 4, 5, 8, -1, -1, -1, -1},
-        {0, 4, 11, 0, 11, 3, 4, 5, 11, 2, 11, 1, 5, 1, 11, -1},
-        {0, 2, 5, 0, 5, 9, 2, 11, 5, 4, 5, 8, 11, 8, 5, -1},
-        {9, 4, 5, 2, 11, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {2, 5, 10, 3, 5, 2, 3, 4, 5, 3, 8, 4, -1, -1, -1, -1},
-        {5, 10, 2, 5, 2, 4, 4, 2, 0, -1, -1, -1, -1, -1, -1, -1},
-        {3, 10, 2, 3, 5, 10, 3, 8, 5, 4, 5, 8, 0, 1, 9, -1},
-        {5, 10, 2, 5, 2, 4, 1, 9, 2, 9, 4, 2, -1, -1, -1, -1},
-        {8, 4, 5, 8, 5, 3, 3, 5, 1, -1, -1, -1, -1, -1, -1, -1},
-        {0, 4, 5, 1, 0, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {8, 4, 5, 8, 5, 3, 9, 0, 5, 0, 3, 5, -1, -1, -1, -1},
-        {9, 4, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {4, 11, 7, 4, 9, 11, 9, 10, 11, -1, -1, -1, -1, -1, -1, -1},
-        {0, 8, 3, 4, 9, 7, 9, 11, 7, 9, 10, 11, -1, -1, -1, -1},
-        {1, 10, 11, 1, 11, 4, 1, 4, 0, 7, 4, 11, -1, -1, -1, -1},
-        {3, 1, 4, 3, 4, 8, 1, 10, 4, 7, 4, 11, 10, 11, 4, -1},
-        {4, 11, 7, 9, 11, 4, 9, 2, 11, 9, 1, 2, -1, -1, -1, -1},
-        {9, 7, 4, 9, 11, 7, 9, 1, 11, 2, 11, 1, 0, 8, 3, -1},
-        {11, 7, 4, 11, 4, 2, 2, 4, 0, -1, -1, -1, -1, -1, -1, -1},
-        {11, 7, 4, 11, 4, 2, 8, 3, 4, 3, 2, 4, -1, -1, -1, -1},
-        {2, 9, 10, 2, 7, 9, 2, 3, 7, 7, 4, 9, -1, -1, -1, -1},
-        {9, 10, 7, 9, 7, 4, 10, 2, 7, 8, 7, 0, 2, 0, 7, -1},
-        {3, 7, 10, 3, 10, 2, 7, 4, 10, 1, 10, 0, 4, 0, 10, -1},
-        {1, 10, 2, 8, 7, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {4, 9, 1, 4, 1, 7, 7, 1, 3, -1, -1, -1, -1, -1, -1, -1},
-        {4, 9, 1, 4, 1, 7, 0, 8, 1, 8, 7, 1, -1, -1, -1, -1},
-        {4, 0, 3, 7, 4, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {4, 8, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {9, 10, 8, 10, 11, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {3, 0, 9, 3, 9, 11, 11, 9, 10, -1, -1, -1, -1, -1, -1, -1},
-        {0, 1, 10, 0, 10, 8, 8, 10, 11, -1, -1, -1, -1, -1, -1, -1},
-        {3, 1, 10, 11, 3, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {1, 2, 11, 1, 11, 9, 9, 11, 8, -1, -1, -1, -1, -1, -1, -1},
-        {3, 0, 9, 3, 9, 11, 1, 2, 9, 2, 11, 9, -1, -1, -1, -1},
-        {0, 2, 11, 8, 0, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {3, 2, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {2, 3, 8, 2, 8, 10, 10, 8, 9, -1, -1, -1, -1, -1, -1, -1},
-        {9, 10, 2, 0, 9, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {2, 3, 8, 2, 8, 10, 0, 1, 8, 1, 10, 8, -1, -1, -1, -1},
-        {1, 10, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {1, 3, 8, 9, 1, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {0, 9, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {0, 3, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-        {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}};
-
-    int cubeindex = 0;
-    int vertlist[12];
-   /* Determine the index into the edge table which
-      tells us which vertices are inside of the surface */
-   if (grid.val[0] < isolevel) cubeindex |= 1;
-   if (grid.val[1] < isolevel) cubeindex |= 2;
-   if (grid.val[2] < isolevel) cubeindex |= 4;
-   if (grid.val[3] < isolevel) cubeindex |= 8;
-   if (grid.val[4] < isolevel) cubeindex |= 16;
-   if (grid.val[5] < isolevel) cubeindex |= 32;
-   if (grid.val[6] < isolevel) cubeindex |= 64;
-   if (grid.val[7] < isolevel) cubeindex |= 128;
-
-   /* Cube is entirely in/out of the surface */
-   if (edgeTable[cubeindex] == 0)
-      return;
-
-   /* Find the vertices where the surface intersects the cube */
-   if (edgeTable[cubeindex] & 1)
-      vertlist[0]  = vertexInterp(isolevel, grid.p[0], grid.p[1], grid.val[0], grid.val[1]);
-   if (edgeTable[cubeindex] & 2)
-      vertlist[1]  = vertexInterp(isolevel, grid.p[1], grid.p[2], grid.val[1], grid.val[2]);
-   if (edgeTable[cubeindex] & 4)
-      vertlist[2]  = vertexInterp(isolevel, grid.p[2], grid.p[3], grid.val[2], grid.val[3]);
-   if (edgeTable[cubeindex] & 8)
-      vertlist[3]  = vertexInterp(isolevel, grid.p[3], grid.p[0], grid.val[3], grid.val[0]);
-   if (edgeTable[cubeindex] & 16)
-      vertlist[4]  = vertexInterp(isolevel, grid.p[4], grid.p[5], grid.val[4], grid.val[5]);
-   if (edgeTable[cubeindex] & 32)
-      vertlist[5]  = vertexInterp(isolevel, grid.p[5], grid.p[6], grid.val[5], grid.val[6]);
-   if (edgeTable[cubeindex] & 64)
-      vertlist[6]  = vertexInterp(isolevel, grid.p[6], grid.p[7], grid.val[6], grid.val[7]);
-   if (edgeTable[cubeindex] & 128)
-      vertlist[7]  = vertexInterp(isolevel, grid.p[7], grid.p[4], grid.val[7], grid.val[4]);
-   if (edgeTable[cubeindex] & 256)
-      vertlist[8]  = vertexInterp(isolevel, grid.p[0], grid.p[4], grid.val[0], grid.val[4]);
-   if (edgeTable[cubeindex] & 512)
-      vertlist[9]  = vertexInterp(isolevel, grid.p[1], grid.p[5], grid.val[1], grid.val[5]);
-   if (edgeTable[cubeindex] & 1024)
-      vertlist[10] = vertexInterp(isolevel, grid.p[2], grid.p[6], grid.val[2], grid.val[6]);
-   if (edgeTable[cubeindex] & 2048)
-      vertlist[11] = vertexInterp(isolevel, grid.p[3], grid.p[7], grid.val[3], grid.val[7]);
-
-    /* Create the triangles */
-    for (int i = 0; triTable[cubeindex][i] != -1; i += 3)
-    {
-        Triangle t;
-        t.p[0] = vertlist[triTable[cubeindex][i  ]];
-        t.p[1] = vertlist[triTable[cubeindex][i+1]];
-        t.p[2] = vertlist[triTable[cubeindex][i+2]];
-        triangles.push_back(t);
-    }
+    auto attr = new Qt3DCompat::QAttribute(parent);
+    attr->setName(name);
+    attr->setVertexBaseType(Qt3DCompat::QAttribute::Float);
+    attr->setVertexSize(size);
+    attr->setAttributeType(Qt3DCompat::QAttribute::VertexAttribute);
+    attr->setBuffer(buffer);
+    attr->setByteStride(size * sizeof(float));
+    attr->setCount(0);
+    return attr;
 }
 
-/* Linearly interpolate the position where an isosurface cuts
- * an edge between two vertices, each with their own scalar value */
-int MeshBuilder::vertexInterp(float isolevel, Point3I p1, Point3I p2, float valp1, float valp2)
+/* Red for negative values through white to blue for positive ones, as potential maps are
+ * usually colored. A range that doesn't include zero is spread over the whole scale. */
+void propertyColor(float value, float min, float max, float *rgb)
 {
-    std::array<int, 6> key;
-    if (p1 < p2)
-        key = {p1.x, p1.y, p1.z, p2.x, p2.y, p2.z};
+    float t;
+    if (min < 0.0f && max > 0.0f)
+        t = value / std::max(-min, max);
+    else if (max > min)
+        t = 2.0f * (value - min) / (max - min) - 1.0f;
     else
-        key = {p2.x, p2.y, p2.z, p1.x, p1.y, p1.z};
-
-    int index = vertexCache.value(key, -1);
-
-    if (index != -1)
-        return index;
-
-    QVector3D value;
-    double mu;
+        t = 0.0f;
+    t = std::min(std::max(t, -1.0f), 1.0f);
 
-    if (std::abs(isolevel-valp1) < 0.00001)
-        value = p1.toQVector3D();
-    if (std::abs(isolevel-valp2) < 0.00001)
-        value = p2.toQVector3D();
-    if (std::abs(valp1-valp2) < 0.00001)
-        value = p1.toQVector3D();
-    mu = (isolevel - valp1) / (valp2 - valp1);
-    value = QVector3D(p1.x + mu * (p2.x - p1.x),
-                      p1.y + mu * (p2.y - p1.y),
-                      p1.z + mu * (p2.z - p1.z));
-
-    index = vertexList.size();
-    vertexList.push_back(value);
-    vertexCache[key] = index;
-
-    return index;
+    rgb[0] = t < 0.0f ? 1.0f : 1.0f - t;
+    rgb[1] = 1.0f - std::abs(t);
+    rgb[2] = t > 0.0f ? 1.0f : 1.0f + t;
 }
 
-} // namespace
-/* End marching cubes code */
+Qt3DCompat::QAttribute *indexAttribute(Qt3DCompat::QBuffer *buffer, Qt3DCore::QNode *parent)
+{
+    auto attr = new Qt3DCompat::QAttribute(parent);
+    attr->setAttributeType(Qt3DCompat::QAttribute::IndexAttribute);
+    attr->setVertexBaseType(Qt3DCompat::QAttribute::UnsignedInt);
+    attr->setBuffer(buffer);
+    attr->setCount(0);
+    return attr;
+}
+}
 
 IsosurfaceEntity::IsosurfaceEntity(Qt3DCore::QEntity *parent)  : Qt3DCore::QEntity(parent)
 {
@@ -547,37 +116,17 @@ IsosurfaceEntity::IsosurfaceEntity(Qt3DCore::QEntity *parent)  : Qt3DCore::QEnti
 
     geom = new Qt3DCompat::QGeometry(this);
 
-    const int vertexStride = 6 * sizeof(float); /* 3 float vertex + 3 float normal */
     vertexBuffer = new Qt3DCompat::QBuffer(this);
-    vertexAttr = new Qt3DCompat::QAttribute(this);
-    vertexAttr->setName(Qt3DCompat::QAttribute::defaultPositionAttributeName());
-    vertexAttr->setVertexBaseType(Qt3DCompat::QAttribute::Float);
-    vertexAttr->setVertexSize(3);
-    vertexAttr->setAttributeType(Qt3DCompat::QAttribute::VertexAttribute);
-    vertexAttr->setBuffer(vertexBuffer);
-    vertexAttr->setByteStride(vertexStride);
-    vertexAttr->setCount(0);
+    vertexAttr = vertexAttribute(Qt3DCompat::QAttribute::defaultPositionAttributeName(), 0, vertexBuffer, this);
     geom->addAttribute(vertexAttr);
 
     // Do we also need to generate tangents?
     // -> No: https://gamedev.stackexchange.com/questions/199246/what-is-the-purpose-of-tangent-and-bitangent-vertex-attributes
-    normalAttr = new Qt3DCompat::QAttribute(this);
-    normalAttr->setName(Qt3DCompat::QAttribute::defaultNormalAttributeName());
-    normalAttr->setVertexBaseType(Qt3DCompat::QAttribute::Float);
-    normalAttr->setVertexSize(3);
-    normalAttr->setAttributeType(Qt3DCompat::QAttribute::VertexAttribute);
-    normalAttr->setBuffer(vertexBuffer);
-    normalAttr->setByteStride(vertexStride);
-    normalAttr->setByteOffset(3 * sizeof(float));
-    normalAttr->setCount(0);
+    normalAttr = vertexAttribute(Qt3DCompat::QAttribute::defaultNormalAttributeName(), 3 * sizeof(float), vertexBuffer, this);
     geom->addAttribute(normalAttr);
 
     indexBuffer = new Qt3DCompat::QBuffer(this);
-    indexAttr = new Qt3DCompat::QAttribute(this);
-    indexAttr->setAttributeType(Qt3DCompat::QAttribute::IndexAttribute);
-    indexAttr->setVertexBaseType(Qt3DCompat::QAttribute::UnsignedInt);
-    indexAttr->setBuffer(indexBuffer);
-    indexAttr->setCount(0);
+    indexAttr = indexAttribute(indexBuffer, this);
     geom->addAttribute(indexAttr);
 
     geomRender = new Qt3DRender::QGeometryRenderer(this);
@@ -592,62 +141,181 @@ IsosurfaceEntity::IsosurfaceEntity(Qt3DCore::QEntity *parent)  : Qt3DCore::QEnti
     addComponent(material);
     addComponent(geomRender);
     addComponent(transform);
+
+    // The negative lobe's indices follow the positive lobe's in the same index buffer
+    negativeLobe = new Qt3DCore::QEntity(this);
+    negativeMaterial = new Qt3DExtras::QDiffuseSpecularMaterial(negativeLobe);
+    negativeMaterial->setAmbient(QColor::fromRgbF(0.7f, 0.3f, 0.3f, 1.0f));
+    negativeMaterial->setDiffuse(QColor::fromRgbF(1.0f, 1.0f, 1.0f, 0.5f));
+    negativeMaterial->setAlphaBlendingEnabled(true);
+    negativeMaterial->setShininess(100.0);
+
+    auto negativeGeom = new Qt3DCompat::QGeometry(negativeLobe);
+    negativeVertexAttr = vertexAttribute(Qt3DCompat::QAttribute::defaultPositionAttributeName(), 0, vertexBuffer, negativeLobe);
+    negativeGeom->addAttribute(negativeVertexAttr);
+    negativeNormalAttr = vertexAttribute(Qt3DCompat::QAttribute::defaultNormalAttributeName(), 3 * sizeof(float), vertexBuffer, negativeLobe);
+    negativeGeom->addAttribute(negativeNormalAttr);
+    negativeIndexAttr = indexAttribute(indexBuffer, negativeLobe);
+    negativeGeom->addAttribute(negativeIndexAttr);
+
+    auto negativeRender = new Qt3DRender::QGeometryRenderer(negativeLobe);
+    negativeRender->setPrimitiveType(Qt3DRender::QGeometryRenderer::PrimitiveType::Triangles);
+    negativeRender->setGeometry(negativeGeom);
+
+    negativeLobe->addComponent(negativeMaterial);
+    negativeLobe->addComponent(negativeRender);
+    negativeLobe->setEnabled(false);
+
+    colorBuffer = new Qt3DCompat::QBuffer(this);
+    colorAttr = floatAttribute(Qt3DCompat::QAttribute::defaultColorAttributeName(), 3, colorBuffer, this);
+    geom->addAttribute(colorAttr);
+    negativeColorAttr = floatAttribute(Qt3DCompat::QAttribute::defaultColorAttributeName(), 3, colorBuffer, negativeLobe);
+    negativeGeom->addAttribute(negativeColorAttr);
+
+    propertyMaterial = new IsosurfacePropertyMaterial(this);
+    negativePropertyMaterial = new IsosurfacePropertyMaterial(negativeLobe);
 }
 
 IsosurfaceEntity *IsosurfaceEntity::fromData(VolumeData const &volume, QColor color, float threshold)
+{
+    return fromMesh(IsosurfaceMesh::build(volume, threshold), color);
+}
+
+IsosurfaceEntity *IsosurfaceEntity::fromMesh(const IsosurfaceMesh &mesh, QColor color, QColor negativeColor)
 {
     auto result = new IsosurfaceEntity;
 
     result->material->setAmbient(QColor::fromRgbF(color.redF(), color.greenF(), color.blueF(), 1.0f));
     result->material->setDiffuse(QColor::fromRgbF(1.0f, 1.0f, 1.0f, color.alphaF()));
+    result->propertyMaterial->setAlpha(color.alphaF());
+    result->negativePropertyMaterial->setAlpha(color.alphaF());
+    if (negativeColor.isValid())
+    {
+        result->negativeMaterial->setAmbient(QColor::fromRgbF(negativeColor.redF(), negativeColor.greenF(), negativeColor.blueF(), 1.0f));
+        result->negativeMaterial->setDiffuse(QColor::fromRgbF(1.0f, 1.0f, 1.0f, negativeColor.alphaF()));
+        result->negativePropertyMaterial->setAlpha(negativeColor.alphaF());
+    }
+    result->setMesh(mesh);
 
-    MeshBuilder builder;
-    builder.build(volume, threshold);
-
-//    qDebug() << "IsosurfaceEntity:" << builder.vertexList.length() << "vertices," << builder.triangles.length() << "triangles";
-
-    QBuffer vertexData;
-    QBuffer indexData;
+    return result;
+}
 
-    vertexData.buffer().reserve(builder.vertexList.length()*6*sizeof(float)); /* 3 float vertex + 3 float normal */
-    indexData.buffer().reserve(builder.triangles.length()*3*sizeof(uint32_t));
+void IsosurfaceEntity::setMesh(const IsosurfaceMesh &mesh)
+{
+    const int positiveIndexCount = mesh.indexCount - mesh.negativeIndexCount;
+    const auto indexType = mesh.shortIndices ? Qt3DCompat::QAttribute::UnsignedShort : Qt3DCompat::QAttribute::UnsignedInt;
+    vertexAttr->setCount(mesh.vertexCount);
+    normalAttr->setCount(mesh.vertexCount);
+    negativeVertexAttr->setCount(mesh.vertexCount);
+    negativeNormalAttr->setCount(mesh.vertexCount);
+    indexAttr->setVertexBaseType(indexType);
+    indexAttr->setCount(positiveIndexCount);
+    negativeIndexAttr->setVertexBaseType(indexType);
+    negativeIndexAttr->setByteOffset(positiveIndexCount * mesh.indexSize());
+    negativeIndexAttr->setCount(mesh.negativeIndexCount);
+    negativeLobe->setEnabled(mesh.negativeIndexCount > 0);
+    vertexBuffer->setData(mesh.vertexData);
+    indexBuffer->setData(mesh.indexData);
+
+    const bool hasProperty = !mesh.propertyData.isEmpty();
+    if (hasProperty)
+    {
+        const float *values = reinterpret_cast<const float *>(mesh.propertyData.constData());
+        QByteArray colors(mesh.vertexCount * 3 * int(sizeof(float)), Qt::Uninitialized);
+        float *rgb = reinterpret_cast<float *>(colors.data());
+        for (int i = 0; i < mesh.vertexCount; ++i)
+            propertyColor(values[i], mesh.propertyMin, mesh.propertyMax, rgb + i * 3);
 
-    vertexData.open(QIODevice::WriteOnly);
-    indexData.open(QIODevice::WriteOnly);
+        colorBuffer->setData(colors);
+    }
+    colorAttr->setCount(hasProperty ? mesh.vertexCount : 0);
+    negativeColorAttr->setCount(hasProperty ? mesh.vertexCount : 0);
+    setPropertyColors(hasProperty);
+}
 
-    QDataStream vertexStream(&vertexData);
-    vertexStream.setByteOrder(QDataStream::LittleEndian);
-    vertexStream.setFloatingPointPrecision(QDataStream::SinglePrecision);
-    QDataStream indexStream(&indexData);
-    indexStream.setByteOrder(QDataStream::LittleEndian);
+void IsosurfaceEntity::setPropertyColors(bool enabled)
+{
+    if (enabled == showingProperty)
+        return;
+    showingProperty = enabled;
 
-    auto vIter = builder.vertexList.begin();
-    auto nIter = builder.normalList.begin();
-    while (vIter != builder.vertexList.end())
+    if (enabled)
     {
-        // The vertex
-        vertexStream << float(vIter->x()) << float(vIter->y()) << float(vIter->z());
-        vIter++;
-        // The normal
-        vertexStream << float(nIter->x()) << float(nIter->y()) << float(nIter->z());
-        nIter++;
+        removeComponent(material);
+        addComponent(propertyMaterial);
+        negativeLobe->removeComponent(negativeMaterial);
+        negativeLobe->addComponent(negativePropertyMaterial);
     }
-
-    for (auto const &triangle: builder.triangles)
+    else
     {
-        indexStream << uint32_t(triangle.p[0]);
-        indexStream << uint32_t(triangle.p[1]);
-        indexStream << uint32_t(triangle.p[2]);
+        removeComponent(propertyMaterial);
+        addComponent(material);
+        negativeLobe->removeComponent(negativePropertyMaterial);
+        negativeLobe->addComponent(negativeMaterial);
     }
+}
 
-    vertexData.close();
-    indexData.close();
-
-    result->vertexAttr->setCount(builder.vertexList.size());
-    result->normalAttr->setCount(builder.vertexList.size());
-    result->indexAttr->setCount(builder.triangles.size()*3);
-    result->vertexBuffer->setData(vertexData.buffer());
-    result->indexBuffer->setData(indexData.buffer());
+IsosurfacePropertyMaterial::IsosurfacePropertyMaterial(Qt3DCore::QNode *parent) : Qt3DRender::QMaterial(parent)
+{
+    auto shaderGL3 = new Qt3DRender::QShaderProgram();
+    shaderGL3->setVertexShaderCode(Qt3DRender::QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/shaders/gl3/isosurface_property.vert"))));
+    shaderGL3->setFragmentShaderCode(Qt3DRender::QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/shaders/gl3/isosurface_property.frag"))));
+
+    auto shaderRHI = new Qt3DRender::QShaderProgram();
+    shaderRHI->setVertexShaderCode(Qt3DRender::QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/shaders/rhi/isosurface_property.vert"))));
+    shaderRHI->setFragmentShaderCode(Qt3DRender::QShaderProgram::loadSource(QUrl(QStringLiteral("qrc:/shaders/rhi/isosurface_property.frag"))));
+
+    auto techniqueGL3 = new Qt3DRender::QTechnique();
+    techniqueGL3->graphicsApiFilter()->setApi(Qt3DRender::QGraphicsApiFilter::OpenGL);
+    techniqueGL3->graphicsApiFilter()->setMajorVersion(3);
+    techniqueGL3->graphicsApiFilter()->setMinorVersion(1);
+    techniqueGL3->graphicsApiFilter()->setProfile(Qt3DRender::QGraphicsApiFilter::CoreProfile);
+
+    auto techniqueRHI = new Qt3DRender::QTechnique();
+    techniqueRHI->graphicsApiFilter()->setApi(Qt3DRender::QGraphicsApiFilter::RHI);
+    techniqueRHI->graphicsApiFilter()->setMajorVersion(1);
+    techniqueRHI->graphicsApiFilter()->setMinorVersion(0);
+
+    // Shared by both render backends, the defaults match QDiffuseSpecularMaterial's surfaces
+    alphaParam = new Qt3DRender::QParameter(QStringLiteral("alpha"), 0.5f);
+    shininessParam = new Qt3DRender::QParameter(QStringLiteral("shininess"), 100.0f);
+
+    auto filterKey = new Qt3DRender::QFilterKey(this);
+    filterKey->setName(QStringLiteral("renderingStyle"));
+    filterKey->setValue(QStringLiteral("forward"));
+
+    // Blended like QDiffuseSpecularMaterial with alpha blending enabled
+    auto addRenderPass = [filterKey](Qt3DRender::QTechnique *technique, Qt3DRender::QShaderProgram *shader) {
+        auto blendEquation = new Qt3DRender::QBlendEquation();
+        blendEquation->setBlendFunction(Qt3DRender::QBlendEquation::Add);
+
+        auto blendArguments = new Qt3DRender::QBlendEquationArguments();
+        blendArguments->setSourceRgb(Qt3DRender::QBlendEquationArguments::SourceAlpha);
+        blendArguments->setDestinationRgb(Qt3DRender::QBlendEquationArguments::OneMinusSourceAlpha);
+        blendArguments->setSourceAlpha(Qt3DRender::QBlendEquationArguments::One);
+        blendArguments->setDestinationAlpha(Qt3DRender::QBlendEquationArguments::One);
+
+        auto renderPass = new Qt3DRender::QRenderPass();
+        renderPass->setShaderProgram(shader);
+        renderPass->addRenderState(blendEquation);
+        renderPass->addRenderState(blendArguments);
+        renderPass->addRenderState(new Qt3DRender::QNoDepthMask());
+
+        technique->addFilterKey(filterKey);
+        technique->addRenderPass(renderPass);
+    };
+    addRenderPass(techniqueGL3, shaderGL3);
+    addRenderPass(techniqueRHI, shaderRHI);
+
+    auto effect = new Qt3DRender::QEffect(this);
+    effect->addTechnique(techniqueGL3);
+    effect->addTechnique(techniqueRHI);
+    effect->addParameter(alphaParam);
+    effect->addParameter(shininessParam);
+    setEffect(effect);
+}
 
-    return result;
+void IsosurfacePropertyMaterial::setAlpha(float alpha)
+{
+    alphaParam->setValue(alpha);
 }
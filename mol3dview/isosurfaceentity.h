@@ -1,6 +1,7 @@
 #ifndef ISOSURFACEENTITY_H
 #define ISOSURFACEENTITY_H
 
+#include "isosurfacemesh.h"
 #include "volumedata.h"
 
 #include <QBuffer>
@@ -8,6 +9,8 @@
 #include <QEntity>
 #include <QGeometryRenderer>
 #include <QDiffuseSpecularMaterial>
+#include <QMaterial>
+#include <QParameter>
 #include <QTransform>
 
 namespace Qt3DCompat {
@@ -18,6 +21,19 @@ using namespace Qt3DRender;
 #endif
 }
 
+// Lit per vertex colors blended with a constant alpha, QPerVertexColorMaterial is always opaque
+class IsosurfacePropertyMaterial : public Qt3DRender::QMaterial
+{
+    Q_OBJECT
+public:
+    IsosurfacePropertyMaterial(Qt3DCore::QNode *parent = nullptr);
+    void setAlpha(float alpha);
+
+protected:
+    Qt3DRender::QParameter *alphaParam;
+    Qt3DRender::QParameter *shininessParam;
+};
+
 class IsosurfaceEntity : public Qt3DCore::QEntity
 {
     Q_OBJECT
@@ -25,6 +41,10 @@ public:
     IsosurfaceEntity(Qt3DCore::QEntity *parent = nullptr);
 
     static IsosurfaceEntity* fromData(VolumeData const &volume, QColor color, float threshold = 0.0f);
+    static IsosurfaceEntity* fromMesh(IsosurfaceMesh const &mesh, QColor color, QColor negativeColor = QColor());
+
+    // Replace the displayed geometry, e.g. with a higher resolution version of the same surface
+    void setMesh(IsosurfaceMesh const &mesh);
 
     Qt3DExtras::QDiffuseSpecularMaterial *material = nullptr;
     Qt3DCore::QTransform *transform = nullptr;
@@ -37,6 +57,25 @@ public:
     Qt3DCompat::QAttribute *normalAttr = nullptr;
     Qt3DCompat::QBuffer *indexBuffer = nullptr;
     Qt3DCompat::QAttribute *indexAttr = nullptr;
+
+    // The negative lobe of a dual mesh, drawn from the same vertex buffer with its own color
+    Qt3DCore::QEntity *negativeLobe = nullptr;
+    Qt3DExtras::QDiffuseSpecularMaterial *negativeMaterial = nullptr;
+    Qt3DCompat::QAttribute *negativeVertexAttr = nullptr;
+    Qt3DCompat::QAttribute *negativeNormalAttr = nullptr;
+    Qt3DCompat::QAttribute *negativeIndexAttr = nullptr;
+
+    // Meshes with property data are colored per vertex by the property instead of the lobe
+    // colors, colorAttr holds the colors the property values map to
+    Qt3DCompat::QBuffer *colorBuffer = nullptr;
+    Qt3DCompat::QAttribute *colorAttr = nullptr;
+    Qt3DCompat::QAttribute *negativeColorAttr = nullptr;
+    IsosurfacePropertyMaterial *propertyMaterial = nullptr;
+    IsosurfacePropertyMaterial *negativePropertyMaterial = nullptr;
+
+private:
+    void setPropertyColors(bool enabled);
+    bool showingProperty = false;
 };
 
 #endif // ISOSURFACEENTITY_H
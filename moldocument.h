@@ -1,8 +1,9 @@
 #ifndef MOLDOCUMENT_H
 #define MOLDOCUMENT_H
 
+#include "isosurfacemesh.h"
 #include "molstruct.h"
-#include "volumedata.h"
+#include "volumehandle.h"
 
 #include <QMap>
 #include <QVector>
@@ -30,13 +31,33 @@ public:
         QVector<QVector3D> eigenvector;
     };
 
+    // A surface mesh built from one of the volumes, kept so it can be shown without rebuilding
+    struct SurfaceMesh {
+        QString volume;
+        float threshold;
+        QString mode; // IsosurfaceOptions::modeKey() of the options it was built with, plus its region
+        QString property; // The volume mapped onto the mesh, empty for none
+        IsosurfaceMesh mesh;
+    };
+
     MolStruct molecule;
     //TODO: Should we separate volumes we know the purpose of (e.g. the orbitals) from ones
     //      that we find as part of a file (e.g. cube files)?
-    QMap<QString, VolumeData> volumes;
+    QMap<QString, VolumeHandle> volumes;
     QList<MolecularOrbital> orbitals;
     QList<Frequency> frequencies;
 
+    // The surface being displayed when the document was saved
+    QString activeSurface;
+    float activeSurfaceThreshold = 0.01f;
+    float activeSurfaceEnclosedFraction = 0.0f;
+    QString activeSurfaceProperty;
+    bool activeSurfaceHasRegion = false;
+    QVector3D activeSurfaceRegionMin;
+    QVector3D activeSurfaceRegionMax;
+    QVector4D activeSurfaceClipPlane; // Null when the surface isn't clipped
+    QList<SurfaceMesh> surfaceMeshes;
+
     QMap<QString, QString> calculatedProperties;
 };
 
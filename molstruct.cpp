@@ -9,7 +9,7 @@
 #include <algorithm>
 #include <functional>
 #include <cmath>
-#include <QRegularExpression>
+#include <memory>
 
 namespace {
 int parseMolfileCharge(int value) {
@@ -67,22 +67,22 @@ MolStruct MolStruct::fromSDFData(const QByteArray &source)
     // Since we just want to parse the pubchem data we're pretending only V2000 files exist
 
     MolStruct result;
-    QStringList data = QString(source).split(QRegularExpression("[\r\n]"));
-    auto data_iter = data.begin();
+    // Lines are scanned in place, only the ones being parsed are converted to QStrings
+    LineScanner lines(source);
+    auto nextLine = [&lines](const char *error) {
+        if (lines.atEnd())
+            throw QString(error);
+        return QString::fromUtf8(lines.next());
+    };
 
     for (int i = 0; i < 3; i++)
-    {
-        if (data_iter == data.end())
-            throw QString("SDF read error, missing header lines");
-        data_iter++;
-    }
+        nextLine("SDF read error, missing header lines");
 
-    if (data_iter == data.end())
-        throw QString("SDF read error, missing counts line");
+    QString countsLine = nextLine("SDF read error, missing counts line");
 
     // Line format:
     //aaabbblllfffcccsssxxxrrrpppiiimmmvvvvvv
-    QStringList counts_line = splitFixedWidth(*data_iter++, {3, 3});
+    QStringList counts_line = splitFixedWidth(countsLine, {3, 3});
     int num_atoms = intFromList(counts_line, 0);
     int num_bonds = intFromList(counts_line, 1);
 
@@ -91,7 +91,8 @@ MolStruct MolStruct::fromSDFData(const QByteArray &source)
         Atom a;
         // Line format:
         // xxxxx.xxxxyyyyy.yyyyzzzzz.zzzz aaaddcccssshhhbbbvvvHHHrrriiimmmnnneee
-        QStringList atom_line = splitFixedWidth(*data_iter++, {11, 10, 10, 4, 2, 3});
+        QString atomLine = nextLine("SDF read error, missing atom lines");
+        QStringList atom_line = splitFixedWidth(atomLine, {11, 10, 10, 4, 2, 3});
         a.x = doubleFromList(atom_line, 0);
         a.y = doubleFromList(atom_line, 1);
         a.z = doubleFromList(atom_line, 2);
@@ -107,7 +108,8 @@ MolStruct MolStruct::fromSDFData(const QByteArray &source)
         Bond b;
         // Line format:
         //111222tttsssxxxrrrccc
-        QStringList bond_line = splitFixedWidth(*data_iter++, {3, 3, 3});
+        QString bondLine = nextLine("SDF read error, missing bond lines");
+        QStringList bond_line = splitFixedWidth(bondLine, {3, 3, 3});
         b.from = intFromList(bond_line, 0) - 1;
         b.to = intFromList(bond_line, 1) - 1;
         b.order = intFromList(bond_line, 2);
@@ -121,9 +123,9 @@ MolStruct MolStruct::fromSDFData(const QByteArray &source)
             qDebug() << "invalid bond:" << bond_line;
         }
     }
-    while (data_iter != data.end())
+    while (!lines.atEnd())
     {
-        QString line = *data_iter++;
+        QString line = QString::fromUtf8(lines.next());
         if (line.startsWith("M  END"))
             break;
         else if (line.startsWith("M  CHG"))
@@ -152,15 +154,17 @@ MolStruct MolStruct::fromSDFData(const QByteArray &source)
 MolStruct MolStruct::fromXYZData(const QByteArray &source)
 {
     MolStruct result;
-    QStringList data = QString(source).split(QRegularExpression("[\r\n]"));
-    auto data_iter = data.begin();
+    LineScanner lines(source);
+    if (lines.atEnd())
+        throw QString("XYZ read error, missing atom count");
 
-    int numAtoms = toIntOrThrow(*data_iter++);
-    data_iter++; // Comment line
-    for (; data_iter != data.end() && result.atoms.length() != numAtoms; data_iter++)
+    int numAtoms = toIntOrThrow(QString::fromUtf8(lines.next()).trimmed());
+    if (!lines.atEnd())
+        lines.next(); // Comment line
+    while (!lines.atEnd() && result.atoms.length() != numAtoms)
     {
         // Line format: <element> <x> <y> <z>
-        QStringList line = data_iter->split(" ", Qt::SkipEmptyParts);
+        QStringList line = QString::fromUtf8(lines.next()).split(" ", Qt::SkipEmptyParts);
         if (line.size() == 0)
             continue;
         Atom a;
@@ -182,22 +186,22 @@ MolStruct MolStruct::fromXYZData(const QByteArray &source)
 
 MolStruct MolStruct::fromSDF(QString const &filename)
 {
-    QByteArray source;
+    std::unique_ptr<MappedFile> source;
 
-    try {source = readFile(filename); }
+    try {source.reset(new MappedFile(filename)); }
     catch (QString err) { throw QStringLiteral("SDF: ") + err; }
 
-    return fromSDFData(source);
+    return fromSDFData(source->data());
 }
 
 MolStruct MolStruct::fromXYZ(const QString &filename)
 {
-    QByteArray source;
+    std::unique_ptr<MappedFile> source;
 
-    try {source = readFile(filename); }
+    try {source.reset(new MappedFile(filename)); }
     catch (QString err) { throw QStringLiteral("XYZ: ") + err; }
 
-    return fromXYZData(source);
+    return fromXYZData(source->data());
 }
 
 bool MolStruct::isEmpty()
@@ -7,6 +7,7 @@
 #include <QSet>
 #include <QTextStream>
 #include <QDebug>
+#include <memory>
 #include <regex>
 
 namespace {
@@ -36,6 +37,17 @@ namespace {
         return -last;
     }
 
+    // Lines may be slices of a mapped file rather than NUL terminated copies, so they're matched by range
+    bool matchLine(QByteArray const &line, std::cmatch &match, std::regex const &re)
+    {
+        return std::regex_match(line.constData(), line.constData() + line.size(), match, re);
+    }
+
+    bool matchLine(QByteArray const &line, std::regex const &re)
+    {
+        return std::regex_match(line.constData(), line.constData() + line.size(), re);
+    }
+
     std::cmatch nextMatch(LineBuffer const &buffer, int &idx, int endIdx, const std::regex &re)
     {
         std::cmatch match;
@@ -43,7 +55,7 @@ namespace {
         for (; idx < endIdx; idx++)
         {
             const QByteArray &line = buffer.lines.at(idx);
-            if (std::regex_match(line.data(), match, re))
+            if (matchLine(line, match, re))
                 return match;
         }
 
@@ -92,28 +104,21 @@ QByteArray NWChem::molToOptimize(MolStruct mol, QString name, NWChemConfiguratio
 
 MolDocument NWChem::molFromOutputPath(QString path)
 {
-    QFile file(path);
+    std::unique_ptr<MappedFile> source;
 
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
-    {
-        throw QString("NWChem read error, couldn't open file");
-    }
-
-    QByteArray source = file.readAll();
-    if (source.isNull())
-    {
-        throw QString("NWChem read error, couldn't read file");
-    }
+    try {source.reset(new MappedFile(path)); }
+    catch (QString err) { throw QStringLiteral("NWChem ") + err; }
 
-    return molFromOutput(source);
+    return molFromOutput(source->data());
 }
 
 MolDocument NWChem::molFromOutput(QByteArray data)
 {
+    // The lines refer to data rather than copying it, it outlives the parser
     LineBuffer buffer;
     Parser parser(buffer);
 
-    buffer.append(data);
+    buffer.setRawData(data);
     parser.parse();
     return parser.document;
 }
@@ -217,7 +222,7 @@ bool NWChem::Parser::findSections(int startLine, int endLine) {
         const auto &line = buffer.lines.at(currentLine);
         for (const auto &q: queries)
         {
-            if (std::regex_match(line.data(), q.re))
+            if (matchLine(line, q.re))
             {
                 SectionInfo info;
                 info.start = currentLine;
@@ -398,7 +403,7 @@ bool NWChem::Parser::parseConnectivity(int start, int end)
     try {
         for (;curLine < buffer.lines.size(); curLine++)
         {
-            if (std::regex_match(buffer.lines.at(curLine).data(), any_separator_re))
+            if (matchLine(buffer.lines.at(curLine), any_separator_re))
                 break;
 
             QString line = QString::fromUtf8(buffer.lines.at(curLine));
@@ -533,7 +538,7 @@ void NWChem::Parser::parseEnergySection(int sectionIdx) {
     {
         const QByteArray &line = buffer.lines.at(i);
         std::cmatch match;
-        if (std::regex_match(line.data(), match, charge_re))
+        if (matchLine(line, match, charge_re))
         {
             bool ok = false;
             QString s = QString::fromStdString(match.str(1));
@@ -543,7 +548,7 @@ void NWChem::Parser::parseEnergySection(int sectionIdx) {
             else
                 document.calculatedProperties["Charge"] = s;
         }
-        else if (std::regex_match(line.data(), match, spin_re))
+        else if (matchLine(line, match, spin_re))
         {
             bool ok = false;
             QString s = QString::fromStdString(match.str(1));
@@ -553,7 +558,7 @@ void NWChem::Parser::parseEnergySection(int sectionIdx) {
             else
                 document.calculatedProperties["Spin"] = s;
         }
-        else if (std::regex_match(line.data(), match, energy_re))
+        else if (matchLine(line, match, energy_re))
         {
             bool ok = false;
             QString s = QString::fromStdString(match.str(1));
@@ -563,11 +568,11 @@ void NWChem::Parser::parseEnergySection(int sectionIdx) {
             else
                 document.calculatedProperties[energyType] = s;
         }
-        else if (std::regex_match(line.data(), geometry_re))
+        else if (matchLine(line, geometry_re))
         {
             parseGeometry(i, endLine);
         }
-        else if (std::regex_match(line.data(), orbital_re))
+        else if (matchLine(line, orbital_re))
         {
             parseOrbitals(i, endLine);
         }
@@ -581,7 +586,7 @@ void NWChem::Parser::parseEnergySection(int sectionIdx) {
 
                 static const std::regex solvent_name_re("\\s+solvname_long\\s*:\\s*(\\S+)\\s*");
                 static const std::regex solvent_dielec_re("\\s+dielec\\s*:\\s*(-?\\d+.\\d+)\\s*");
-                if (std::regex_match(line.data(), match, solvent_name_re))
+                if (matchLine(line, match, solvent_name_re))
                 {
                     QString s = QString::fromStdString(match.str(1));
                     if (s.isEmpty())
@@ -589,7 +594,7 @@ void NWChem::Parser::parseEnergySection(int sectionIdx) {
                     else
                         document.calculatedProperties["Solvent"] = s;
                 }
-                else if (std::regex_match(line.data(), match, solvent_dielec_re))
+                else if (matchLine(line, match, solvent_dielec_re))
                 {
                     bool ok = false;
                     QString s = QString::fromStdString(match.str(1));
@@ -1,6 +1,9 @@
 #include "parsehelpers.h"
 
 #include <QFile>
+#include <charconv>
+#include <cstring>
+#include <limits>
 
 QByteArray readFile(const QString &filename)
 {
@@ -20,6 +23,49 @@ QByteArray readFile(const QString &filename)
     return data;
 }
 
+MappedFile::MappedFile(const QString &filename, LineEndings lineEndings) : file(filename)
+{
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        throw QString("read error, couldn't open file");
+    }
+
+    qint64 size = file.size();
+    uchar *mapped = nullptr;
+    if (size > 0 && size <= std::numeric_limits<int>::max())
+        mapped = file.map(0, size);
+
+    // Mapped data doesn't get QIODevice::Text's line ending translation, so files that
+    // need it (or can't be mapped) take the buffered path instead.
+    if (mapped && (lineEndings == LineEndings::Raw || !memchr(mapped, '\r', size)))
+    {
+        contents = QByteArray::fromRawData(reinterpret_cast<const char *>(mapped), size);
+        return;
+    }
+
+    if (mapped)
+        file.unmap(mapped);
+    file.close();
+
+    contents = readFile(filename);
+}
+
+QByteArray LineScanner::next()
+{
+    if (pos == end)
+        throw QString("Unexpected end of file");
+
+    const char *lineEnd = pos;
+    while (lineEnd != end && *lineEnd != '\n' && *lineEnd != '\r')
+        lineEnd++;
+
+    QByteArray line = QByteArray::fromRawData(pos, lineEnd - pos);
+    pos = lineEnd;
+    if (pos != end)
+        pos += (*pos == '\r' && pos + 1 != end && pos[1] == '\n') ? 2 : 1;
+    return line;
+}
+
 int indexOrThrow(QByteArray const &data, const char *target, int from)
 {
     int result = data.indexOf(target, from);
@@ -61,6 +107,47 @@ double doubleFromList(QStringList const &data, int index)
     return toDoubleOrThrow(atOrThrow(data, index));
 }
 
+bool toDouble(const char *begin, const char *end, double &value)
+{
+    // std::from_chars doesn't accept a leading '+' but QString::toDouble() does
+    if (begin != end && *begin == '+')
+        begin++;
+    if (begin == end)
+        return false;
+
+#if defined(__cpp_lib_to_chars)
+    auto result = std::from_chars(begin, end, value);
+    return result.ec == std::errc() && result.ptr == end;
+#else
+    // Floating point from_chars isn't available everywhere yet (e.g. older libc++)
+    bool ok = false;
+    value = QByteArray::fromRawData(begin, end - begin).toDouble(&ok);
+    return ok;
+#endif
+}
+
+bool scanDoubleOrThrow(const char *&pos, const char *end, double &value)
+{
+    auto isSpace = [](char c) {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+    };
+
+    while (pos != end && isSpace(*pos))
+        pos++;
+    if (pos == end)
+        return false;
+
+    const char *tokenEnd = pos;
+    while (tokenEnd != end && !isSpace(*tokenEnd))
+        tokenEnd++;
+
+    if (!toDouble(pos, tokenEnd, value))
+        throw QString("Could not convert QString to double:") + QString::fromLatin1(pos, tokenEnd - pos);
+
+    pos = tokenEnd;
+    return true;
+}
+
 QStringList splitFixedWidth(QString &str, QList<int> sizes)
 {
     QStringList result;
@@ -3,10 +3,46 @@
 
 #include <QString>
 #include <QList>
+#include <QFile>
 
 
 QByteArray readFile(QString const &filename);
 
+// Read only view of a file's contents that memory maps the file when possible instead of
+// copying it into a heap buffer. The data is only valid for the lifetime of the MappedFile.
+class MappedFile
+{
+public:
+    enum class LineEndings {
+        Raw,       // The parser handles "\r\n" itself, the file is always mapped
+        Normalized // "\r\n" must become "\n", files containing '\r' are read through QIODevice::Text
+    };
+
+    explicit MappedFile(QString const &filename, LineEndings lineEndings = LineEndings::Raw);
+
+    QByteArray const &data() const { return contents; }
+
+private:
+    QFile file;
+    QByteArray contents;
+};
+
+// Iterates over the lines of a buffer without copying it, "\n", "\r\n" and "\r" all end a line.
+// The returned lines share the buffer's data, so they're only valid as long as it is.
+class LineScanner
+{
+public:
+    explicit LineScanner(QByteArray const &data) : pos(data.constData()), end(data.constData() + data.size()) {}
+
+    bool atEnd() const { return pos == end; }
+    // The next line without its line ending, throws a QString if there are no more lines
+    QByteArray next();
+
+private:
+    const char *pos;
+    const char *end;
+};
+
 int indexOrThrow(QByteArray const &data, const char *target, int from);
 QString const &atOrThrow(QStringList const &data, int index);
 
@@ -16,6 +52,13 @@ double toDoubleOrThrow(QString const &str);
 int intFromList(QStringList const &data, int index);
 double doubleFromList(QStringList const &data, int index);
 
+// Convert the bytes in [begin, end) to a double without any intermediate copies,
+// returns false if they aren't a valid number.
+bool toDouble(const char *begin, const char *end, double &value);
+// Scan the next whitespace separated number in [pos, end) and advance pos past it,
+// returns false once only whitespace remains.
+bool scanDoubleOrThrow(const char *&pos, const char *end, double &value);
+
 QStringList splitFixedWidth(QString &str, QList<int> sizes);
 
 #endif // PARSEHELPERS_H
@@ -1,6 +1,8 @@
 #include "preferenceswindow.h"
 #include "ui_preferenceswindow.h"
+#include "isosurfacemesh.h"
 #include "systempaths.h"
+#include "volumedata.h"
 
 #include <QSettings>
 
@@ -13,6 +15,26 @@ PreferencesWindow::PreferencesWindow(QWidget *parent) :
     QSettings appSettings;
     ui->NWChemEntry->setText(appSettings.value("NWChemPath").toString());
     ui->NWChemEntry->setPlaceholderText(SystemPaths::nwchemBinDefault());
+
+    ui->VolumeEncodingEntry->addItem(tr("32-bit float (exact)"), int(VolumeData::Encoding::Float32));
+    ui->VolumeEncodingEntry->addItem(tr("16-bit float"), int(VolumeData::Encoding::Float16));
+    ui->VolumeEncodingEntry->addItem(tr("16-bit logarithmic"), int(VolumeData::Encoding::Log16));
+    ui->VolumeEncodingEntry->addItem(tr("8-bit logarithmic"), int(VolumeData::Encoding::Log8));
+    ui->VolumeEncodingEntry->setCurrentIndex(ui->VolumeEncodingEntry->findData(int(VolumeData::defaultEncoding())));
+
+    ui->IsosurfaceEngineEntry->addItem(tr("Flying Edges"), "FlyingEdges");
+    ui->IsosurfaceEngineEntry->addItem(tr("Marching Cubes (reference)"), "MarchingCubes");
+    bool marchingCubes = IsosurfaceOptions::fromSettings().engine == IsosurfaceOptions::Engine::MarchingCubes;
+    ui->IsosurfaceEngineEntry->setCurrentIndex(marchingCubes ? 1 : 0);
+
+    ui->IsosurfaceNormalsEntry->addItem(tr("Averaged from faces"), "Faces");
+    ui->IsosurfaceNormalsEntry->addItem(tr("Volume gradient (smoother)"), "Gradient");
+    bool gradient = IsosurfaceOptions::fromSettings().normals == IsosurfaceOptions::Normals::Gradient;
+    ui->IsosurfaceNormalsEntry->setCurrentIndex(gradient ? 1 : 0);
+
+    ui->IsosurfaceTriangleBudgetEntry->setValue(IsosurfaceOptions::fromSettings().targetTriangles);
+    ui->IsosurfaceMaxErrorEntry->setValue(IsosurfaceOptions::fromSettings().maxError);
+
     connect(ui->buttonBox, &QDialogButtonBox::accepted, this, &PreferencesWindow::saveSettings);
     connect(ui->buttonBox, &QDialogButtonBox::rejected, this, &PreferencesWindow::saveSettings);
 }
@@ -26,6 +48,11 @@ void PreferencesWindow::saveSettings()
 {
     QSettings appSettings;
     appSettings.setValue("NWChemPath", ui->NWChemEntry->text());
+    appSettings.setValue("VolumeEncoding", ui->VolumeEncodingEntry->currentData().toInt());
+    appSettings.setValue("IsosurfaceEngine", ui->IsosurfaceEngineEntry->currentData().toString());
+    appSettings.setValue("IsosurfaceNormals", ui->IsosurfaceNormalsEntry->currentData().toString());
+    appSettings.setValue("IsosurfaceTriangleBudget", ui->IsosurfaceTriangleBudgetEntry->value());
+    appSettings.setValue("IsosurfaceMaxError", ui->IsosurfaceMaxErrorEntry->value());
     close();
 }
 
@@ -2,9 +2,11 @@
 #include "propertieswindow.h"
 #include "ui_propertieswindow.h"
 
+#include <algorithm>
 #include <cmath>
 #include <QCloseEvent>
 #include <QSettings>
+#include <QSignalBlocker>
 #include <QTextStream>
 
 PropertiesWindow::PropertiesWindow(QWidget *parent) :
@@ -19,11 +21,35 @@ PropertiesWindow::PropertiesWindow(QWidget *parent) :
     connect(ui->label, &QLabel::linkActivated, this, [this](QString link){
         const auto orbitalPrefix = QStringLiteral("orbital://");
         const auto vibrationPrefix = QStringLiteral("vibration://");
+        const auto isovaluePrefix = QStringLiteral("isovalue://");
+        const auto enclosePrefix = QStringLiteral("enclose://");
+        const auto propertyPrefix = QStringLiteral("property://");
         if (link.startsWith(orbitalPrefix))
         {
             QString surfaceName = link.mid(orbitalPrefix.size());
             if(MainWindow *mainwindow = qobject_cast<MainWindow *>(this->parent()))
-                mainwindow->generateNWChemSurface(surfaceName, 1.0E-02);
+                mainwindow->generateNWChemSurface(surfaceName, surfaceThreshold, surfaceEnclosedFraction);
+        }
+        else if (link.startsWith(isovaluePrefix) || link.startsWith(enclosePrefix))
+        {
+            if (link.startsWith(isovaluePrefix))
+            {
+                surfaceThreshold = link.mid(isovaluePrefix.size()).toFloat();
+                surfaceEnclosedFraction = 0.0f;
+            }
+            else
+            {
+                surfaceEnclosedFraction = link.mid(enclosePrefix.size()).toFloat();
+            }
+
+            updateIsovalueSlider();
+            if(MainWindow *mainwindow = qobject_cast<MainWindow *>(this->parent()))
+                mainwindow->setSurfaceIsovalue(surfaceThreshold, surfaceEnclosedFraction);
+        }
+        else if (link.startsWith(propertyPrefix))
+        {
+            if(MainWindow *mainwindow = qobject_cast<MainWindow *>(this->parent()))
+                mainwindow->setSurfaceProperty(link.mid(propertyPrefix.size()));
         }
         else if (link.startsWith(vibrationPrefix))
         {
@@ -33,6 +59,25 @@ PropertiesWindow::PropertiesWindow(QWidget *parent) :
         }
     });
 
+    // Dragging the slider rebuilds the surface as it moves, only the cells near the new
+    // isovalue are visited so this stays interactive. The steps are coalesced so a fast drag
+    // doesn't queue a build for every value it passes.
+    ui->isovalueSlider->setRange(0, (sliderMaxExponent - sliderMinExponent) * sliderStepsPerDecade);
+    isovalueTimer.setSingleShot(true);
+    isovalueTimer.setInterval(30);
+    connect(&isovalueTimer, &QTimer::timeout, this, [this]() {
+        if(MainWindow *mainwindow = qobject_cast<MainWindow *>(this->parent()))
+            mainwindow->setSurfaceIsovalue(surfaceThreshold, surfaceEnclosedFraction);
+    });
+    connect(ui->isovalueSlider, &QSlider::valueChanged, this, [this](int value) {
+        surfaceThreshold = std::pow(10.0f, sliderMinExponent + float(value) / sliderStepsPerDecade);
+        surfaceEnclosedFraction = 0.0f;
+        updateIsovalueSlider();
+        if (!isovalueTimer.isActive())
+            isovalueTimer.start();
+    });
+    updateIsovalueSlider();
+
     showData({}, false);
 }
 
@@ -55,6 +100,19 @@ void PropertiesWindow::hideEvent(QHideEvent *)
 }
 
 
+void PropertiesWindow::updateIsovalueSlider()
+{
+    if (surfaceEnclosedFraction > 0.0f)
+    {
+        ui->isovalueLabel->setText(QStringLiteral("%1%").arg(surfaceEnclosedFraction * 100));
+        return;
+    }
+
+    QSignalBlocker blocker(ui->isovalueSlider);
+    ui->isovalueSlider->setValue(std::lround((std::log10(surfaceThreshold) - sliderMinExponent) * sliderStepsPerDecade));
+    ui->isovalueLabel->setText(QString::number(surfaceThreshold, 'g', 3));
+}
+
 void PropertiesWindow::showData(const MolDocument &document, bool optimizerAvailable)
 {
     QString newLabelText;
@@ -121,6 +179,49 @@ void PropertiesWindow::showData(const MolDocument &document, bool optimizerAvail
         stream << "</table><br>";
     }
 
+    // Volumes that aren't one of the listed orbitals, e.g. densities or the contents of a cube file
+    QStringList otherVolumes;
+    for (auto iter = document.volumes.begin(); iter != document.volumes.end(); iter++)
+    {
+        auto matchesId = [&iter](MolDocument::MolecularOrbital const &o) { return o.id == iter.key(); };
+        if (std::none_of(document.orbitals.begin(), document.orbitals.end(), matchesId))
+            otherVolumes.push_back(iter.key());
+    }
+
+    if (!otherVolumes.isEmpty())
+    {
+        const QString format = QStringLiteral("<tr><td><a href='orbital://%1'>%1</a></td></tr>");
+        stream << "<b>Surfaces:</b>";
+        stream << "<table>";
+        for (auto const &name: otherVolumes)
+            stream << format.arg(name);
+        stream << "</table><br>";
+    }
+
+    ui->isovalueRow->setVisible(!document.orbitals.isEmpty() || !document.volumes.isEmpty());
+    if (!document.orbitals.isEmpty() || !document.volumes.isEmpty())
+    {
+        const QString isovalueFormat = QStringLiteral("<a href='isovalue://%1'>%1</a> ");
+        const QString encloseFormat = QStringLiteral("<a href='enclose://%1'>%2%</a> ");
+        stream << "<b>Isovalue:</b> ";
+        for (auto value: {0.001, 0.005, 0.01, 0.02, 0.05})
+            stream << isovalueFormat.arg(value);
+        stream << "<br>\n<b>Enclose density:</b> ";
+        for (auto fraction: {0.5, 0.9, 0.95, 0.99})
+            stream << encloseFormat.arg(fraction).arg(fraction * 100);
+        stream << "<br>\n";
+    }
+
+    // Any volume can be sampled onto the surface of another, e.g. the potential on a density surface
+    if (document.volumes.size() > 1)
+    {
+        const QString propertyFormat = QStringLiteral("<a href='property://%1'>%1</a> ");
+        stream << "<b>Color surface by:</b> <a href='property://'>none</a> ";
+        for (auto iter = document.volumes.begin(); iter != document.volumes.end(); iter++)
+            stream << propertyFormat.arg(iter.key());
+        stream << "<br>\n";
+    }
+
     if (!document.frequencies.isEmpty())
     {
         stream << "<br>\n<b>Frequencies:</b>";
@@ -3,6 +3,7 @@
 
 #include "moldocument.h"
 
+#include <QTimer>
 #include <QWidget>
 
 namespace Ui {
@@ -24,6 +25,17 @@ public:
 
 private:
     Ui::PropertiesWindow *ui;
+
+    // The slider moves along a log scale of isovalues
+    static const int sliderStepsPerDecade = 100;
+    static const int sliderMinExponent = -4;
+    static const int sliderMaxExponent = 1;
+    void updateIsovalueSlider();
+    // Slider steps are sent to the main window at most once per interval while dragging
+    QTimer isovalueTimer;
+
+    float surfaceThreshold = 1.0E-02f;
+    float surfaceEnclosedFraction = 0.0f;
 };
 
 #endif // PROPERTIESWINDOW_H
@@ -0,0 +1,17 @@
+#version 150 core
+
+in vec3 position;
+in vec3 normal;
+in vec3 color;
+
+uniform float alpha;
+uniform float shininess;
+out vec4 fragColor;
+
+void main()
+{
+    // Lit from the camera, the inside of a clipped surface is lit like the outside
+    float facing = abs(dot(normalize(normal), normalize(-position)));
+    float specular = pow(facing, shininess);
+    fragColor = vec4(color * (0.3 + 0.7 * facing) + vec3(0.5 * specular), alpha);
+}
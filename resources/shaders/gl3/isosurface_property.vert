@@ -0,0 +1,21 @@
+#version 150 core
+
+in vec3 vertexPosition;
+in vec3 vertexNormal;
+in vec3 vertexColor;
+
+out vec3 position;
+out vec3 normal;
+out vec3 color;
+
+uniform mat4 modelView;
+uniform mat3 modelViewNormal;
+uniform mat4 modelViewProjection;
+
+void main()
+{
+    position = vec3(modelView * vec4(vertexPosition, 1.0));
+    normal = modelViewNormal * vertexNormal;
+    color = vertexColor;
+    gl_Position = modelViewProjection * vec4(vertexPosition, 1.0);
+}
@@ -0,0 +1,20 @@
+#version 450
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec3 color;
+
+layout(location = 0) out vec4 fragColor;
+
+layout(std140, binding = 2) uniform qt3d_custom_uniforms {
+  float alpha;
+  float shininess;
+};
+
+void main()
+{
+    // Lit from the camera, the inside of a clipped surface is lit like the outside
+    float facing = abs(dot(normalize(normal), normalize(-position)));
+    float specular = pow(facing, shininess);
+    fragColor = vec4(color * (0.3 + 0.7 * facing) + vec3(0.5 * specular), alpha);
+}
@@ -0,0 +1,28 @@
+#version 450
+
+layout(location = 0) in vec3 vertexPosition;
+layout(location = 1) in vec3 vertexNormal;
+layout(location = 2) in vec3 vertexColor;
+
+layout(location = 0) out vec3 position;
+layout(location = 1) out vec3 normal;
+layout(location = 2) out vec3 color;
+
+layout(std140, binding = 1) uniform qt3d_command_uniforms {
+  mat4 modelMatrix;
+  mat4 inverseModelMatrix;
+  mat4 modelViewMatrix;
+  mat3 modelNormalMatrix;
+  mat4 inverseModelViewMatrix;
+  mat4 mvp;
+  mat4 inverseModelViewProjectionMatrix;
+};
+
+void main()
+{
+    position = vec3(modelViewMatrix * vec4(vertexPosition, 1.0));
+    // Surfaces are only ever scaled uniformly, so this is enough for the normals
+    normal = mat3(modelViewMatrix) * vertexNormal;
+    color = vertexColor;
+    gl_Position = mvp * vec4(vertexPosition, 1.0);
+}
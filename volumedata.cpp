@@ -1,12 +1,818 @@
 #include "volumedata.h"
+#include <QDataStream>
 #include <QDebug>
+#include <QSettings>
+#include <QtEndian>
+#include <QtConcurrentMap>
+#include <QFloat16>
+#include <QMutex>
+#include <QMutexLocker>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
 
-VolumeData::VolumeData() : xDim(0), yDim(0), zDim(0)
+namespace {
+    /* Serialized layout, all values little-endian:
+     *   char[4]    magic ("CVVL")
+     *   quint32    format version
+     *   qint32[3]  xDim, yDim, zDim
+     *   quint32    encoding of the values
+     *   float[16]  transform, row-major
+     *   float[2]   logMax, logRange (version 2 and later)
+     *   ...        the values, as float32, uint16 or uint8 depending on the encoding
+     *
+     * Version 1 only supported float32 values.
+     */
+    const char volumeMagic[4] = {'C', 'V', 'V', 'L'};
+    const quint32 volumeVersion = 2;
+    const int volumeHeaderSizeV1 = 4 + 4 + 3 * 4 + 4 + 16 * 4;
+    const int volumeHeaderSize = volumeHeaderSizeV1 + 2 * 4;
+
+    // Number of octaves below the largest magnitude that the log encodings can represent,
+    // anything smaller is stored as zero.
+    const float log16Range = 32.0f;
+    const float log8Range = 12.0f;
+
+    int valueSize(VolumeData::Encoding encoding)
+    {
+        if (encoding == VolumeData::Encoding::Float32)
+            return 4;
+        else if (encoding == VolumeData::Encoding::Log8)
+            return 1;
+        return 2;
+    }
+
+    int logLevels(int bits)
+    {
+        return (1 << (bits - 1)) - 1;
+    }
+
+    struct StatisticsChunk {
+        int begin;
+        int end;
+        float min = std::numeric_limits<float>::infinity();
+        float max = -std::numeric_limits<float>::infinity();
+        QVector<qint64> positiveCounts;
+        QVector<qint64> negativeCounts;
+        QVector<double> sums;
+        QVector<double> squareSums;
+    };
+
+    // Finds the Statistics histogram bin of a positive finite magnitude from its binary exponent
+    // rather than a log10 per value. A power of two spans less than a third of a decade, so the
+    // exponent leaves only a few bins and the lookup just steps past the edges between them.
+    class MagnitudeBins {
+    public:
+        MagnitudeBins()
+        {
+            for (int bin = 0; bin < binCount; bin++)
+                edges[bin + 1] = VolumeData::Statistics::binLowerEdge(bin + 1);
+            for (int exponent = 0; exponent < 256; exponent++)
+            {
+                // Zero and subnormals have exponent 0, their magnitudes are far below the first edge
+                float lowest = exponent == 0 ? 0.0f : std::ldexp(1.0f, exponent - 127);
+                int bin = 0;
+                while (bin < binCount - 1 && edges[bin + 1] <= lowest)
+                    bin++;
+                firstBin[exponent] = bin;
+            }
+        }
+
+        int bin(float magnitude) const
+        {
+            quint32 bits;
+            memcpy(&bits, &magnitude, sizeof(bits));
+            int bin = firstBin[bits >> 23];
+            while (bin < binCount - 1 && edges[bin + 1] <= magnitude)
+                bin++;
+            return bin;
+        }
+
+    private:
+        static const int binCount = VolumeData::Statistics::binCount;
+        // edges[i] is the lower edge of bin i, edges[0] isn't used as the first bin has no lower bound
+        float edges[binCount + 1] = {};
+        // The lowest bin a magnitude with each biased exponent can fall into
+        int firstBin[256];
+    };
+
+    template <typename T>
+    void encodeLog(QVector<float> const &values, float logMax, float logRange, QVector<T> &out)
+    {
+        const int bits = sizeof(T) * 8;
+        const int levels = logLevels(bits);
+        const float logMin = logMax - logRange;
+        const float scale = (levels - 1) / logRange;
+
+        out.resize(values.size());
+        T *outPtr = out.data();
+        for (int i = 0; i < values.size(); ++i)
+        {
+            float v = values[i];
+            float magnitude = std::abs(v);
+            T code = 0;
+            if (magnitude > 0.0f && std::isfinite(magnitude))
+            {
+                float t = (std::log2(magnitude) - logMin) * scale;
+                if (t >= -0.5f)
+                {
+                    code = T(1 + std::lround(std::min(std::max(t, 0.0f), float(levels - 1))));
+                    if (v < 0.0f)
+                        code |= T(1 << (bits - 1));
+                }
+            }
+            outPtr[i] = code;
+        }
+    }
+
+    template <typename T>
+    void copyStrided(const T *in, int count, int step, T *out)
+    {
+        for (int i = 0; i < count; ++i)
+            out[i] = in[i * step];
+    }
+}
+
+struct VolumeData::DerivedCache {
+    QMutex lock;
+    bool hasBrickIndex = false;
+    BrickIndex brickIndex;
+    QVector<VolumeData> pyramid;
+    bool hasStatistics = false;
+    Statistics statistics;
+};
+
+VolumeData::VolumeData() : xDim(0), yDim(0), zDim(0), derived(std::make_shared<DerivedCache>())
 {
 
 }
 
-VolumeData::VolumeData(int x, int y, int z) : xDim(x), yDim(y), zDim(z)
+VolumeData::VolumeData(int x, int y, int z) : xDim(x), yDim(y), zDim(z), derived(std::make_shared<DerivedCache>())
 {
     data.resize(xDim*yDim*zDim);
 }
+
+VolumeData::VolumeData(const QByteArray &serialized) : VolumeData()
+{
+    if (serialized.size() < volumeHeaderSizeV1 || !serialized.startsWith(QByteArray(volumeMagic, 4)))
+        throw QString("Invalid volume data");
+
+    QDataStream stream(serialized);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    stream.skipRawData(4);
+
+    quint32 version;
+    quint32 encodingValue;
+    qint32 x, y, z;
+    stream >> version >> x >> y >> z >> encodingValue;
+
+    if (version < 1 || version > volumeVersion)
+        throw QString("Unknown volume version: %1").arg(version);
+    if (encodingValue > quint32(Encoding::Log8) || (version == 1 && encodingValue != quint32(Encoding::Float32)))
+        throw QString("Unknown volume encoding: %1").arg(encodingValue);
+    if (x < 0 || y < 0 || z < 0)
+        throw QString("Invalid volume dimensions");
+
+    float values[16];
+    for (auto &v: values)
+        stream >> v;
+    QMatrix4x4 matrix(values);
+
+    int headerSize = volumeHeaderSizeV1;
+    float logMaxValue = 0.0f;
+    float logRangeValue = 0.0f;
+    if (version >= 2)
+    {
+        headerSize = volumeHeaderSize;
+        stream >> logMaxValue >> logRangeValue;
+    }
+
+    Encoding volumeEncoding = Encoding(encodingValue);
+    qint64 count = qint64(x) * y * z;
+    if (serialized.size() - headerSize != count * valueSize(volumeEncoding))
+        throw QString("Volume size doesn't match its dimensions");
+
+    xDim = x;
+    yDim = y;
+    zDim = z;
+    transform = matrix;
+    encoding = volumeEncoding;
+    logMax = logMaxValue;
+    logRange = logRangeValue;
+
+    const char *payload = serialized.constData() + headerSize;
+    if (encoding == Encoding::Float32)
+    {
+        data.resize(count);
+        qFromLittleEndian<quint32>(payload, count, data.data());
+    }
+    else if (encoding == Encoding::Log8)
+    {
+        data8.resize(count);
+        memcpy(data8.data(), payload, count);
+    }
+    else
+    {
+        data16.resize(count);
+        qFromLittleEndian<quint16>(payload, count, data16.data());
+    }
+
+    buildDecodeTable();
+}
+
+void VolumeData::getValues(int index, int count, float *out) const
+{
+    if (encoding == Encoding::Float32)
+    {
+        memcpy(out, data.constData() + index, count * sizeof(float));
+    }
+    else if (encoding == Encoding::Log8)
+    {
+        const quint8 *codes = data8.constData() + index;
+        for (int i = 0; i < count; ++i)
+            out[i] = decodeTable[codes[i]];
+    }
+    else
+    {
+        const quint16 *codes = data16.constData() + index;
+        for (int i = 0; i < count; ++i)
+            out[i] = decodeTable[codes[i]];
+    }
+}
+
+void VolumeData::sample(const QVector3D *points, int count, float *out) const
+{
+    if (!size())
+    {
+        std::fill(out, out + count, 0.0f);
+        return;
+    }
+
+    // Volume transforms are affine, so the mapping to grid coordinates is written out
+    // term by term rather than calling QMatrix4x4::map() with its projective divide
+    const QMatrix4x4 toGrid = transform.inverted();
+    const float m00 = toGrid(0, 0), m01 = toGrid(0, 1), m02 = toGrid(0, 2), m03 = toGrid(0, 3);
+    const float m10 = toGrid(1, 0), m11 = toGrid(1, 1), m12 = toGrid(1, 2), m13 = toGrid(1, 3);
+    const float m20 = toGrid(2, 0), m21 = toGrid(2, 1), m22 = toGrid(2, 2), m23 = toGrid(2, 3);
+    // Axes with a single point interpolate between that point and itself
+    const int xStride = xDim > 1 ? yDim * zDim : 0;
+    const int yStride = yDim > 1 ? zDim : 0;
+    const int zStride = zDim > 1 ? 1 : 0;
+
+    // Points are handled in batches: the cell offsets and weights are computed first in a
+    // loop with no calls or loads from the volume, which the compiler is free to vectorize,
+    // then the corners are gathered.
+    const int batchSize = 64;
+    int offsets[batchSize];
+    float tx[batchSize], ty[batchSize], tz[batchSize];
+
+    auto locate = [](float coord, int dim, int &cell) {
+        // Clamped before converting to int, written so NaN (e.g. from a degenerate transform)
+        // goes to 0 rather than reaching the conversion
+        if (!(coord >= 0.0f))
+            coord = 0.0f;
+        coord = std::min(coord, float(dim - 1));
+        cell = std::min(int(coord), std::max(dim - 2, 0));
+        return coord - cell;
+    };
+
+    for (int begin = 0; begin < count; begin += batchSize)
+    {
+        const int n = std::min(batchSize, count - begin);
+        for (int i = 0; i < n; ++i)
+        {
+            const QVector3D &p = points[begin + i];
+            int x, y, z;
+            tx[i] = locate(m00 * p.x() + m01 * p.y() + m02 * p.z() + m03, xDim, x);
+            ty[i] = locate(m10 * p.x() + m11 * p.y() + m12 * p.z() + m13, yDim, y);
+            tz[i] = locate(m20 * p.x() + m21 * p.y() + m22 * p.z() + m23, zDim, z);
+            offsets[i] = x * yDim * zDim + y * zDim + z;
+        }
+
+        for (int i = 0; i < n; ++i)
+        {
+            const int o = offsets[i];
+            float c00 = valueAt(o) + (valueAt(o + zStride) - valueAt(o)) * tz[i];
+            float c01 = valueAt(o + yStride) + (valueAt(o + yStride + zStride) - valueAt(o + yStride)) * tz[i];
+            float c10 = valueAt(o + xStride) + (valueAt(o + xStride + zStride) - valueAt(o + xStride)) * tz[i];
+            float c11 = valueAt(o + xStride + yStride) + (valueAt(o + xStride + yStride + zStride) - valueAt(o + xStride + yStride)) * tz[i];
+            float c0 = c00 + (c01 - c00) * ty[i];
+            float c1 = c10 + (c11 - c10) * ty[i];
+            out[begin + i] = c0 + (c1 - c0) * tx[i];
+        }
+    }
+}
+
+float *VolumeData::mutableValues()
+{
+    if (encoding != Encoding::Float32)
+        *this = encoded(Encoding::Float32);
+    derived = std::make_shared<DerivedCache>();
+    return data.data();
+}
+
+VolumeData VolumeData::encoded(Encoding e) const
+{
+    if (e == encoding)
+        return *this;
+
+    VolumeData result;
+    result.xDim = xDim;
+    result.yDim = yDim;
+    result.zDim = zDim;
+    result.transform = transform;
+    result.encoding = e;
+
+    QVector<float> values;
+    if (encoding == Encoding::Float32)
+    {
+        values = data;
+    }
+    else
+    {
+        values.resize(size());
+        getValues(0, size(), values.data());
+    }
+
+    if (e == Encoding::Float32)
+    {
+        result.data = values;
+    }
+    else if (e == Encoding::Float16)
+    {
+        result.data16.resize(values.size());
+        qFloatToFloat16(reinterpret_cast<qfloat16 *>(result.data16.data()), values.constData(), values.size());
+    }
+    else
+    {
+        float maxMagnitude = 0.0f;
+        for (float v: values)
+            if (std::isfinite(v))
+                maxMagnitude = std::max(maxMagnitude, std::abs(v));
+
+        result.logMax = maxMagnitude > 0.0f ? std::log2(maxMagnitude) : 0.0f;
+        if (e == Encoding::Log16)
+        {
+            result.logRange = log16Range;
+            encodeLog(values, result.logMax, result.logRange, result.data16);
+        }
+        else
+        {
+            result.logRange = log8Range;
+            encodeLog(values, result.logMax, result.logRange, result.data8);
+        }
+    }
+
+    result.buildDecodeTable();
+    return result;
+}
+
+qint64 VolumeData::byteSize() const
+{
+    return qint64(data.size()) * sizeof(float) +
+           qint64(data16.size()) * sizeof(quint16) +
+           qint64(data8.size()) * sizeof(quint8) +
+           qint64(decodeTable.size()) * sizeof(float);
+}
+
+qint64 VolumeData::derivedByteSize() const
+{
+    if (!derived->lock.tryLock())
+        return 0;
+
+    qint64 bytes = 0;
+    if (derived->hasBrickIndex)
+    {
+        BrickIndex const &index = derived->brickIndex;
+        bytes += qint64(index.minValues.size() + index.maxValues.size()) * sizeof(float) +
+                 qint64(index.byMin.size() + index.byMax.size()) * sizeof(int);
+    }
+    if (derived->hasStatistics)
+    {
+        Statistics const &stats = derived->statistics;
+        bytes += qint64(stats.positiveCounts.size() + stats.negativeCounts.size()) * sizeof(qint64) +
+                 qint64(stats.cumulativeDensity.size()) * sizeof(double);
+    }
+    for (VolumeData const &level : derived->pyramid)
+        bytes += level.byteSize() + level.derivedByteSize();
+
+    derived->lock.unlock();
+    return bytes;
+}
+
+VolumeData::Encoding VolumeData::defaultEncoding()
+{
+    int value = QSettings().value("VolumeEncoding", int(Encoding::Float32)).toInt();
+    if (value < int(Encoding::Float32) || value > int(Encoding::Log8))
+        return Encoding::Float32;
+    return Encoding(value);
+}
+
+VolumeData::BrickIndex const &VolumeData::brickIndex() const
+{
+    QMutexLocker locker(&derived->lock);
+    BrickIndex &index = derived->brickIndex;
+    if (derived->hasBrickIndex)
+        return index;
+
+    // A brick of n cells covers n + 1 points, the points on a shared face count towards both bricks
+    const int brickSize = BrickIndex::brickSize;
+    auto brickCount = [](int points) { return std::max(points - 1 + brickSize - 1, 0) / brickSize; };
+    index.xBricks = brickCount(xDim);
+    index.yBricks = brickCount(yDim);
+    index.zBricks = brickCount(zDim);
+
+    const int count = index.xBricks * index.yBricks * index.zBricks;
+    index.minValues.fill(std::numeric_limits<float>::infinity(), count);
+    index.maxValues.fill(-std::numeric_limits<float>::infinity(), count);
+
+    // Each brick along x is filled by one task, the planes on its faces are read by both neighbors
+    QVector<int> xBricks(index.xBricks);
+    std::iota(xBricks.begin(), xBricks.end(), 0);
+    QtConcurrent::blockingMap(xBricks, [this, &index](int bx) {
+        QVector<float> row(zDim);
+        const int xEnd = std::min((bx + 1) * brickSize, xDim - 1);
+        for (int x = bx * brickSize; x <= xEnd; ++x)
+        {
+            for (int y = 0; y < yDim; ++y)
+            {
+                int byFirst = std::max(y - 1, 0) / brickSize;
+                int byLast = std::min(y / brickSize, index.yBricks - 1);
+                getValues(x*yDim*zDim + y*zDim, zDim, row.data());
+
+                for (int bz = 0; bz < index.zBricks; ++bz)
+                {
+                    float rowMin = std::numeric_limits<float>::infinity();
+                    float rowMax = -std::numeric_limits<float>::infinity();
+                    int zEnd = std::min((bz + 1) * brickSize, zDim - 1);
+                    for (int z = bz * brickSize; z <= zEnd; ++z)
+                    {
+                        float v = row[z];
+                        // NaN never compares less than the isovalue, treat it as matching any range
+                        if (std::isnan(v))
+                        {
+                            rowMin = -std::numeric_limits<float>::infinity();
+                            rowMax = std::numeric_limits<float>::infinity();
+                            break;
+                        }
+                        rowMin = std::min(rowMin, v);
+                        rowMax = std::max(rowMax, v);
+                    }
+
+                    for (int by = byFirst; by <= byLast; ++by)
+                    {
+                        int offset = index.offset(bx, by, bz);
+                        index.minValues[offset] = std::min(index.minValues[offset], rowMin);
+                        index.maxValues[offset] = std::max(index.maxValues[offset], rowMax);
+                    }
+                }
+            }
+        }
+    });
+
+    index.byMin.resize(count);
+    std::iota(index.byMin.begin(), index.byMin.end(), 0);
+    index.byMax = index.byMin;
+    std::sort(index.byMin.begin(), index.byMin.end(), [&index](int a, int b) {
+        return index.minValues[a] < index.minValues[b];
+    });
+    std::sort(index.byMax.begin(), index.byMax.end(), [&index](int a, int b) {
+        return index.maxValues[a] < index.maxValues[b];
+    });
+
+    derived->hasBrickIndex = true;
+    return index;
+}
+
+bool VolumeData::BrickIndex::isSigned() const
+{
+    for (float value: minValues)
+        if (value < 0.0f && std::isfinite(value))
+            return true;
+    return false;
+}
+
+/* For sign > 0 a brick is active if min < threshold <= max, for sign < 0 the values are negated
+ * so it's min <= -threshold < max. The bricks matching the min condition are a prefix of byMin
+ * and the ones matching the max condition a suffix of byMax, only the shorter of the two is
+ * searched for bricks that match the other condition too. */
+QVector<int> VolumeData::BrickIndex::activeBricks(float threshold, float sign) const
+{
+    const float value = sign > 0.0f ? threshold : -threshold;
+
+    auto minEnd = sign > 0.0f
+            ? std::lower_bound(byMin.begin(), byMin.end(), value, [this](int b, float v) { return minValues[b] < v; })
+            : std::upper_bound(byMin.begin(), byMin.end(), value, [this](float v, int b) { return v < minValues[b]; });
+    auto maxBegin = sign > 0.0f
+            ? std::lower_bound(byMax.begin(), byMax.end(), value, [this](int b, float v) { return maxValues[b] < v; })
+            : std::upper_bound(byMax.begin(), byMax.end(), value, [this](float v, int b) { return v < maxValues[b]; });
+
+    QVector<int> result;
+    if (minEnd - byMin.begin() < byMax.end() - maxBegin)
+    {
+        for (auto iter = byMin.begin(); iter != minEnd; ++iter)
+            if (sign > 0.0f ? maxValues[*iter] >= value : maxValues[*iter] > value)
+                result.push_back(*iter);
+    }
+    else
+    {
+        for (auto iter = maxBegin; iter != byMax.end(); ++iter)
+            if (sign > 0.0f ? minValues[*iter] < value : minValues[*iter] <= value)
+                result.push_back(*iter);
+    }
+
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+float VolumeData::Statistics::binLowerEdge(int bin)
+{
+    return std::pow(10.0f, minExponent + float(bin) / binsPerDecade);
+}
+
+float VolumeData::Statistics::thresholdForEnclosedFraction(float fraction) const
+{
+    if (cumulativeDensity.isEmpty() || cumulativeDensity[0] <= 0.0)
+        return 0.0f;
+
+    const double target = cumulativeDensity[0] * std::min(std::max(fraction, 0.0f), 1.0f);
+    int bin = binCount - 1;
+    while (bin > 0 && cumulativeDensity[bin] < target)
+        bin--;
+
+    // Interpolate within the bin, in log space, by how much of its density is needed
+    double above = bin + 1 < binCount ? cumulativeDensity[bin + 1] : 0.0;
+    double inBin = cumulativeDensity[bin] - above;
+    double position = inBin > 0.0 ? std::min((target - above) / inBin, 1.0) : 1.0;
+    float exponent = minExponent + (bin + 1 - position) / binsPerDecade;
+    return std::pow(10.0f, exponent);
+}
+
+VolumeData::Statistics const &VolumeData::statistics() const
+{
+    QMutexLocker locker(&derived->lock);
+    Statistics &stats = derived->statistics;
+    if (derived->hasStatistics)
+        return stats;
+
+    const int binCount = Statistics::binCount;
+    const int chunkSize = 1 << 18;
+    QVector<StatisticsChunk> chunks;
+    for (int begin = 0; begin < size(); begin += chunkSize)
+    {
+        StatisticsChunk chunk;
+        chunk.begin = begin;
+        chunk.end = std::min(begin + chunkSize, size());
+        chunks.push_back(chunk);
+    }
+
+    static const MagnitudeBins magnitudeBins;
+    QtConcurrent::blockingMap(chunks, [this](StatisticsChunk &chunk) {
+        chunk.positiveCounts.fill(0, binCount);
+        chunk.negativeCounts.fill(0, binCount);
+        chunk.sums.fill(0.0, binCount);
+        chunk.squareSums.fill(0.0, binCount);
+
+        QVector<float> values(chunk.end - chunk.begin);
+        getValues(chunk.begin, values.size(), values.data());
+        for (float v: values)
+        {
+            if (!std::isfinite(v))
+                continue;
+            chunk.min = std::min(chunk.min, v);
+            chunk.max = std::max(chunk.max, v);
+            if (v == 0.0f)
+                continue;
+
+            float magnitude = std::abs(v);
+            int bin = magnitudeBins.bin(magnitude);
+            if (v > 0.0f)
+                chunk.positiveCounts[bin]++;
+            else
+                chunk.negativeCounts[bin]++;
+            chunk.sums[bin] += magnitude;
+            chunk.squareSums[bin] += double(magnitude) * magnitude;
+        }
+    });
+
+    QVector<double> sums(binCount, 0.0);
+    QVector<double> squareSums(binCount, 0.0);
+    stats.positiveCounts.fill(0, binCount);
+    stats.negativeCounts.fill(0, binCount);
+    float minValue = std::numeric_limits<float>::infinity();
+    float maxValue = -std::numeric_limits<float>::infinity();
+    for (auto const &chunk: chunks)
+    {
+        minValue = std::min(minValue, chunk.min);
+        maxValue = std::max(maxValue, chunk.max);
+        for (int i = 0; i < binCount; ++i)
+        {
+            stats.positiveCounts[i] += chunk.positiveCounts[i];
+            stats.negativeCounts[i] += chunk.negativeCounts[i];
+            sums[i] += chunk.sums[i];
+            squareSums[i] += chunk.squareSums[i];
+        }
+    }
+
+    // No finite values leaves the range at zero
+    if (minValue <= maxValue)
+    {
+        stats.min = minValue;
+        stats.max = maxValue;
+    }
+
+    QVector<double> const &density = stats.isSigned() ? squareSums : sums;
+    stats.cumulativeDensity.fill(0.0, binCount);
+    double total = 0.0;
+    for (int i = binCount - 1; i >= 0; --i)
+    {
+        total += density[i];
+        stats.cumulativeDensity[i] = total;
+    }
+
+    derived->hasStatistics = true;
+    return stats;
+}
+
+VolumeData VolumeData::downsampled(int level) const
+{
+    if (level <= 0)
+        return *this;
+
+    QMutexLocker locker(&derived->lock);
+    QVector<VolumeData> &pyramid = derived->pyramid;
+    while (pyramid.size() < level)
+    {
+        VolumeData next = pyramid.isEmpty() ? halved() : pyramid.last().halved();
+        pyramid.append(next);
+    }
+
+    return pyramid[level - 1];
+}
+
+VolumeData VolumeData::halved() const
+{
+    VolumeData result = emptyLike((xDim + 1) / 2, (yDim + 1) / 2, (zDim + 1) / 2);
+    QMatrix4x4 scale;
+    scale.scale(2.0f);
+    result.transform = transform * scale;
+
+    int outIndex = 0;
+    for (int x = 0; x < xDim; x += 2)
+    {
+        for (int y = 0; y < yDim; y += 2)
+        {
+            copyCodes(x*yDim*zDim + y*zDim, result.zDim, 2, result, outIndex);
+            outIndex += result.zDim;
+        }
+    }
+
+    return result;
+}
+
+VolumeData VolumeData::cropped(int x0, int y0, int z0, int x1, int y1, int z1) const
+{
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    z0 = std::max(z0, 0);
+    x1 = std::min(x1, xDim);
+    y1 = std::min(y1, yDim);
+    z1 = std::min(z1, zDim);
+    if (x1 <= x0 || y1 <= y0 || z1 <= z0)
+        return VolumeData();
+
+    VolumeData result = emptyLike(x1 - x0, y1 - y0, z1 - z0);
+    QMatrix4x4 offset;
+    offset.translate(x0, y0, z0);
+    result.transform = transform * offset;
+
+    // Only the rows inside the region are copied
+    int outIndex = 0;
+    for (int x = x0; x < x1; ++x)
+    {
+        for (int y = y0; y < y1; ++y)
+        {
+            copyCodes(x*yDim*zDim + y*zDim + z0, result.zDim, 1, result, outIndex);
+            outIndex += result.zDim;
+        }
+    }
+
+    return result;
+}
+
+VolumeData VolumeData::cropped(QVector3D min, QVector3D max) const
+{
+    // The box is mapped corner by corner, the grid may not be aligned to the world axes
+    const QMatrix4x4 toGrid = transform.inverted();
+    QVector3D low(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+    QVector3D high = -low;
+    for (int i = 0; i < 8; ++i)
+    {
+        QVector3D corner(i & 1 ? max.x() : min.x(), i & 2 ? max.y() : min.y(), i & 4 ? max.z() : min.z());
+        QVector3D p = toGrid.map(corner);
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            low[axis] = std::min(low[axis], p[axis]);
+            high[axis] = std::max(high[axis], p[axis]);
+        }
+    }
+
+    // Clamped before converting, a box far outside the grid mustn't overflow
+    auto lower = [](float v, int dim) { return int(std::floor(std::min(std::max(v, -1.0f), float(dim)))); };
+    auto upper = [](float v, int dim) { return int(std::ceil(std::min(std::max(v, -1.0f), float(dim)))) + 1; };
+    return cropped(lower(low.x(), xDim), lower(low.y(), yDim), lower(low.z(), zDim),
+                   upper(high.x(), xDim), upper(high.y(), yDim), upper(high.z(), zDim));
+}
+
+VolumeData VolumeData::emptyLike(int x, int y, int z) const
+{
+    VolumeData result;
+    result.xDim = x;
+    result.yDim = y;
+    result.zDim = z;
+    result.encoding = encoding;
+    result.logMax = logMax;
+    result.logRange = logRange;
+    result.decodeTable = decodeTable;
+
+    if (encoding == Encoding::Float32)
+        result.data.resize(result.size());
+    else if (encoding == Encoding::Log8)
+        result.data8.resize(result.size());
+    else
+        result.data16.resize(result.size());
+
+    return result;
+}
+
+void VolumeData::copyCodes(int index, int count, int step, VolumeData &out, int outIndex) const
+{
+    if (encoding == Encoding::Float32)
+        copyStrided(data.constData() + index, count, step, out.data.data() + outIndex);
+    else if (encoding == Encoding::Log8)
+        copyStrided(data8.constData() + index, count, step, out.data8.data() + outIndex);
+    else
+        copyStrided(data16.constData() + index, count, step, out.data16.data() + outIndex);
+}
+
+void VolumeData::buildDecodeTable()
+{
+    decodeTable.clear();
+
+    if (encoding == Encoding::Float16)
+    {
+        QVector<quint16> codes(1 << 16);
+        for (int i = 0; i < codes.size(); ++i)
+            codes[i] = quint16(i);
+        decodeTable.resize(codes.size());
+        qFloatFromFloat16(decodeTable.data(), reinterpret_cast<const qfloat16 *>(codes.constData()), codes.size());
+    }
+    else if (encoding == Encoding::Log16 || encoding == Encoding::Log8)
+    {
+        const int bits = encoding == Encoding::Log16 ? 16 : 8;
+        const int levels = logLevels(bits);
+        const float logMin = logMax - logRange;
+        const float step = logRange / (levels - 1);
+
+        decodeTable.resize(1 << bits);
+        for (int code = 0; code < decodeTable.size(); ++code)
+        {
+            int m = code & levels;
+            float value = m ? std::exp2(logMin + (m - 1) * step) : 0.0f;
+            decodeTable[code] = (code >> (bits - 1)) ? -value : value;
+        }
+    }
+}
+
+QByteArray VolumeData::serialize() const
+{
+    QByteArray result;
+    qint64 count = size();
+    int bytesPerValue = valueSize(encoding);
+    result.reserve(volumeHeaderSize + count * bytesPerValue);
+
+    QDataStream stream(&result, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    stream.writeRawData(volumeMagic, 4);
+    stream << volumeVersion << qint32(xDim) << qint32(yDim) << qint32(zDim) << quint32(encoding);
+
+    float values[16];
+    transform.copyDataTo(values);
+    for (auto v: values)
+        stream << v;
+    stream << logMax << logRange;
+
+    result.resize(volumeHeaderSize + count * bytesPerValue);
+    char *payload = result.data() + volumeHeaderSize;
+    if (encoding == Encoding::Float32)
+        qToLittleEndian<quint32>(data.constData(), count, payload);
+    else if (encoding == Encoding::Log8)
+        memcpy(payload, data8.constData(), count);
+    else
+        qToLittleEndian<quint16>(data16.constData(), count, payload);
+
+    return result;
+}
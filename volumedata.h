@@ -1,14 +1,27 @@
 #ifndef VOLUMEDATA_H
 #define VOLUMEDATA_H
 
+#include <QByteArray>
 #include <QVector>
 #include <QMatrix4x4>
 #include <QVector3D>
 
+#include <memory>
+
 class VolumeData {
 public:
     VolumeData();
     VolumeData(int x, int y, int z);
+    // Load a volume written by serialize(), throws a QString if the data is invalid
+    explicit VolumeData(QByteArray const &serialized);
+
+    enum class Encoding {
+        Float32,
+        Float16,
+        // Sign and log scaled magnitude relative to the largest value in the volume
+        Log16,
+        Log8
+    };
 
     int size() const
     {
@@ -16,14 +29,151 @@ public:
     }
     float getAt(int x, int y, int z) const
     {
-        return data[x*yDim*zDim + y*zDim + z];
+        return valueAt(x*yDim*zDim + y*zDim + z);
     }
+    float valueAt(int index) const
+    {
+        if (encoding == Encoding::Float32)
+            return data[index];
+        else if (encoding == Encoding::Log8)
+            return decodeTable[data8[index]];
+        return decodeTable[data16[index]];
+    }
+    // Decode count values starting at index into out
+    void getValues(int index, int count, float *out) const;
+    // Trilinearly interpolate the volume at count points given in world space (i.e. after
+    // transform), points outside the grid take the value at the nearest face
+    void sample(const QVector3D *points, int count, float *out) const;
+
+    // The values of a Float32 volume for writing, e.g. to fill a new volume. Any other encoding
+    // is converted to Float32 first. The brick index, statistics and downsampled levels shared
+    // with copies of the volume are detached, so writing through this doesn't affect the copies.
+    float *mutableValues();
+
+    // Return a copy of this volume stored with a different encoding
+    VolumeData encoded(Encoding e) const;
+    // Memory used by the values
+    qint64 byteSize() const;
+    // Memory used by the brick index, statistics and downsampled levels built so far. Doesn't
+    // wait for any that are being built, those are only counted once they're finished.
+    qint64 derivedByteSize() const;
+
+    // The encoding new volumes should be stored with, from the application settings
+    static Encoding defaultEncoding();
+
+    // Value range of each brick of brickSize^3 cells, bricks on the upper edges may be smaller
+    struct BrickIndex {
+        static const int brickSize = 8;
+        int xBricks = 0;
+        int yBricks = 0;
+        int zBricks = 0;
+        QVector<float> minValues;
+        QVector<float> maxValues;
+        // The brick offsets sorted by their min and max values, so the bricks that straddle
+        // a value can be found without visiting the ones that don't
+        QVector<int> byMin;
+        QVector<int> byMax;
+
+        int offset(int bx, int by, int bz) const
+        {
+            return (bx*yBricks + by)*zBricks + bz;
+        }
+        // The brick whose points include the point at x, y, z
+        int pointOffset(int x, int y, int z) const
+        {
+            return offset(std::min(x / brickSize, xBricks - 1),
+                          std::min(y / brickSize, yBricks - 1),
+                          std::min(z / brickSize, zBricks - 1));
+        }
+        // True if the brick may contain cells with corners on both sides of value
+        bool mayCross(int offset, float value) const
+        {
+            return minValues[offset] < value && maxValues[offset] >= value;
+        }
+
+        // The offsets of the bricks that may contain the surface where sign * value crosses
+        // threshold, in increasing order. All the points of any other brick are on the same
+        // side of the surface, given by allInside().
+        QVector<int> activeBricks(float threshold, float sign = 1.0f) const;
+        // True if sign * value < threshold for every point of an inactive brick
+        bool allInside(int offset, float threshold, float sign = 1.0f) const
+        {
+            return sign > 0.0f ? maxValues[offset] < threshold : minValues[offset] > -threshold;
+        }
+        // True if any finite value is negative, like Statistics::isSigned() but found from the
+        // brick ranges. Bricks containing NaN have an unbounded range and aren't counted.
+        bool isSigned() const;
+    };
+    // Computed on first use and shared between copies of the volume, until one of them
+    // calls mutableValues().
+    BrickIndex const &brickIndex() const;
+
+    struct Statistics {
+        // The histograms bin magnitudes logarithmically, binsPerDecade bins per power of ten
+        // between 10^minExponent and 10^maxExponent. Magnitudes outside the range are counted
+        // in the first or last bin, zeros aren't counted.
+        static const int minExponent = -12;
+        static const int maxExponent = 4;
+        static const int binsPerDecade = 10;
+        static const int binCount = (maxExponent - minExponent) * binsPerDecade;
+
+        float min = 0.0f;
+        float max = 0.0f;
+        QVector<qint64> positiveCounts;
+        QVector<qint64> negativeCounts;
+        // The density enclosed by the surface at each bin's lower edge, summed from the top bin
+        // down. For signed volumes (e.g. orbitals) the density is value^2, otherwise the value.
+        QVector<double> cumulativeDensity;
+
+        bool isSigned() const
+        {
+            return min < 0.0f;
+        }
+        static float binLowerEdge(int bin);
+        // The isovalue at which the |value| >= isovalue region encloses fraction of the total density
+        float thresholdForEnclosedFraction(float fraction) const;
+    };
+    // Computed on first use and shared like brickIndex()
+    Statistics const &statistics() const;
+
+    // Level 0 is the volume itself, each following level keeps every other point
+    // along each axis. Levels are built on first use and shared like brickIndex().
+    VolumeData downsampled(int level) const;
+
+    // The points from (x0, y0, z0) up to but not including (x1, y1, z1), clamped to the volume.
+    // The transform is adjusted so the result lies in the same place as the region did.
+    // Like downsampled() the result keeps this volume's encoding, its codes are copied unchanged.
+    VolumeData cropped(int x0, int y0, int z0, int x1, int y1, int z1) const;
+    // The smallest cropped() volume that covers the world space box from min to max
+    VolumeData cropped(QVector3D min, QVector3D max) const;
+
+    // Compact binary representation used to store volumes in project files
+    QByteArray serialize() const;
 
     int xDim;
     int yDim;
     int zDim;
-    QVector<float> data;
     QMatrix4x4 transform;
+
+private:
+    // Only written through mutableValues(), the derived data shared between copies depends on them
+    Encoding encoding = Encoding::Float32;
+    QVector<float> data;     // Values for Float32
+    QVector<quint16> data16; // Codes for Float16 and Log16
+    QVector<quint8> data8;   // Codes for Log8
+    float logMax = 0.0f;     // log2 of the largest magnitude for the Log encodings
+    float logRange = 0.0f;   // log2 of the ratio between the largest and smallest nonzero magnitude
+    QVector<float> decodeTable; // The value of each code for the non-Float32 encodings
+
+    void buildDecodeTable();
+    VolumeData halved() const;
+    // An uninitialized x*y*z volume with this volume's encoding and decode table
+    VolumeData emptyLike(int x, int y, int z) const;
+    // Copy count codes, taking every step'th one from index, into out at outIndex
+    void copyCodes(int index, int count, int step, VolumeData &out, int outIndex) const;
+
+    struct DerivedCache;
+    std::shared_ptr<DerivedCache> derived;
 };
 
 #endif // VOLUMEDATA_H
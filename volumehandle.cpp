@@ -0,0 +1,202 @@
+#include "volumehandle.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <algorithm>
+#include <atomic>
+#include <list>
+
+namespace {
+std::atomic<quint64> nextEntryId(1);
+}
+
+struct VolumeHandle::Entry
+{
+    ~Entry();
+
+    const quint64 id = nextEntryId++;
+    std::function<VolumeData()> loader;
+    std::function<QByteArray()> serializedReader;
+    // Held while the loader runs, so other threads wanting this volume wait for it to finish
+    // rather than decoding it again, without blocking access to any other volume
+    QMutex loadLock;
+    VolumeData volume;
+    bool resident = false;
+    qint64 bytes = 0;
+};
+
+class VolumeCache
+{
+public:
+    static VolumeCache &instance()
+    {
+        static VolumeCache cache;
+        return cache;
+    }
+
+    // Mark entry as the most recently used, then evict others until we're within budget.
+    // The caller must hold the mutex.
+    void touch(VolumeHandle::Entry *entry)
+    {
+        // The brick index, statistics and pyramid are built after loading by whoever uses the
+        // volume, so its size is measured again each time it's requested
+        qint64 bytes = entry->volume.byteSize() + entry->volume.derivedByteSize();
+        auto iter = std::find(entries.begin(), entries.end(), entry);
+        if (iter != entries.end())
+        {
+            entries.erase(iter);
+            used -= entry->bytes;
+        }
+        entry->bytes = bytes;
+        used += bytes;
+        entries.push_front(entry);
+
+        while (used > budget && entries.size() > 1)
+        {
+            VolumeHandle::Entry *last = entries.back();
+            entries.pop_back();
+            used -= last->bytes;
+            last->volume = VolumeData();
+            last->resident = false;
+        }
+    }
+
+    // The caller must hold the mutex
+    void remove(VolumeHandle::Entry *entry)
+    {
+        auto iter = std::find(entries.begin(), entries.end(), entry);
+        if (iter != entries.end())
+        {
+            entries.erase(iter);
+            used -= entry->bytes;
+        }
+    }
+
+    QMutex mutex;
+    qint64 budget = qint64(1024) * 1024 * 1024;
+    qint64 used = 0;
+    std::list<VolumeHandle::Entry *> entries;
+};
+
+VolumeHandle::Entry::~Entry()
+{
+    if (!loader)
+        return;
+
+    auto &cache = VolumeCache::instance();
+    QMutexLocker lock(&cache.mutex);
+    if (resident)
+        cache.remove(this);
+}
+
+VolumeHandle::VolumeHandle(VolumeData volume) : d(std::make_shared<Entry>())
+{
+    d->volume = volume;
+    d->resident = true;
+}
+
+VolumeHandle VolumeHandle::fromLoader(std::function<VolumeData ()> loader, std::function<QByteArray ()> serializedReader)
+{
+    VolumeHandle result;
+    result.d = std::make_shared<Entry>();
+    result.d->loader = loader;
+    result.d->serializedReader = serializedReader;
+    return result;
+}
+
+void VolumeHandle::setLoader(std::function<VolumeData ()> loader, std::function<QByteArray ()> serializedReader)
+{
+    if (!d || !d->loader || !loader)
+        return;
+
+    QMutexLocker loadLock(&d->loadLock);
+    d->loader = loader;
+    d->serializedReader = serializedReader;
+}
+
+VolumeData VolumeHandle::data() const
+{
+    if (!d)
+        return {};
+
+    // Volumes that were never loaded lazily aren't managed by the cache
+    if (!d->loader)
+        return d->volume;
+
+    auto &cache = VolumeCache::instance();
+    {
+        QMutexLocker lock(&cache.mutex);
+        if (d->resident)
+        {
+            cache.touch(d.get());
+            return d->volume;
+        }
+    }
+
+    // The cache lock isn't held while decoding, only this volume's load lock
+    QMutexLocker loadLock(&d->loadLock);
+    {
+        QMutexLocker lock(&cache.mutex);
+        if (d->resident)
+        {
+            cache.touch(d.get());
+            return d->volume;
+        }
+    }
+
+    VolumeData volume = d->loader();
+
+    QMutexLocker lock(&cache.mutex);
+    d->volume = volume;
+    d->resident = true;
+    cache.touch(d.get());
+
+    return volume;
+}
+
+bool VolumeHandle::isLoaded() const
+{
+    if (!d)
+        return false;
+    if (!d->loader)
+        return true;
+
+    auto &cache = VolumeCache::instance();
+    QMutexLocker lock(&cache.mutex);
+    return d->resident;
+}
+
+QByteArray VolumeHandle::serialized() const
+{
+    if (!d)
+        return VolumeData().serialize();
+
+    std::function<QByteArray()> serializedReader;
+    {
+        QMutexLocker loadLock(&d->loadLock);
+        serializedReader = d->serializedReader;
+    }
+
+    if (serializedReader && !isLoaded())
+        return serializedReader();
+    return data().serialize();
+}
+
+quint64 VolumeHandle::id() const
+{
+    return d ? d->id : 0;
+}
+
+void VolumeHandle::setCacheBudget(qint64 bytes)
+{
+    auto &cache = VolumeCache::instance();
+    QMutexLocker lock(&cache.mutex);
+    cache.budget = bytes;
+}
+
+qint64 VolumeHandle::cacheBudget()
+{
+    auto &cache = VolumeCache::instance();
+    QMutexLocker lock(&cache.mutex);
+    return cache.budget;
+}
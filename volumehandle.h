@@ -0,0 +1,47 @@
+#ifndef VOLUMEHANDLE_H
+#define VOLUMEHANDLE_H
+
+#include "volumedata.h"
+
+#include <functional>
+#include <memory>
+
+class VolumeCache;
+
+// Reference to a volume that may not have been decoded yet. Handles created by fromLoader()
+// only run the loader when the data is first requested, the result is then kept in a shared
+// cache that drops the least recently used volumes once it exceeds its memory budget.
+class VolumeHandle
+{
+public:
+    VolumeHandle() = default;
+    VolumeHandle(VolumeData volume);
+
+    // If given, serializedReader returns the volume's VolumeData::serialize() bytes without
+    // decoding them, so a volume that was never loaded can be saved again as it is.
+    static VolumeHandle fromLoader(std::function<VolumeData()> loader,
+                                   std::function<QByteArray()> serializedReader = nullptr);
+    // Replace the loader and serializedReader of a handle created by fromLoader(), for every
+    // copy of it, e.g. once its volume has been saved to another file. Does nothing otherwise.
+    void setLoader(std::function<VolumeData()> loader, std::function<QByteArray()> serializedReader = nullptr);
+
+    // Return the volume, loading it if necessary. Throws a QString if the loader fails.
+    VolumeData data() const;
+    bool isLoaded() const;
+    // The volume's serialized form, only decoding it if it has no serializedReader. Throws a
+    // QString if reading fails.
+    QByteArray serialized() const;
+    // Identifies the volume whether or not it's loaded, copies of a handle share the same id
+    // and ids aren't reused. 0 for an empty handle.
+    quint64 id() const;
+
+    static void setCacheBudget(qint64 bytes);
+    static qint64 cacheBudget();
+
+private:
+    friend class VolumeCache;
+    struct Entry;
+    std::shared_ptr<Entry> d;
+};
+
+#endif // VOLUMEHANDLE_H